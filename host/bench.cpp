@@ -0,0 +1,134 @@
+// Host benchmark: ns/op and table reads per call of the main `pizzalend` functions on synthetic tables
+//
+// usage: pizzalend_bench [--accounts N] [--reserves N] [--liqdtorders N] [--iterations N] [--seed N]
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "native.hpp"
+#include "generate.hpp"
+
+using namespace pizzalend;
+
+static volatile double sink;
+
+template <typename F>
+static void measure( const char* function, const uint32_t iterations, F&& f )
+{
+    eosio::host::count = {};
+    const auto start = std::chrono::steady_clock::now();
+    for(uint32_t i = 0; i < iterations; ++i) sink = sink + f( i );
+    const double ns = std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - start ).count();
+
+    const auto& c = eosio::host::count;
+    const double n = iterations;
+    printf( "%-48s %12.0f %8.2f %8.2f %8.2f %8.2f\n", function, ns / n, c.tables / n, c.lookups / n, c.rows / n, c.unpacked / n );
+}
+
+int main( int argc, char** argv )
+{
+    synthetic::MarketSize size { .accounts = 10000, .liqdtorders = 500 };
+    uint32_t iterations = 1000;
+    for(int i = 1; i + 1 < argc; i += 2) {
+        const uint64_t value = std::strtoull( argv[i + 1], nullptr, 10 );
+        if(!strcmp(argv[i], "--accounts")) size.accounts = value;
+        else if(!strcmp(argv[i], "--reserves")) size.reserves = value;
+        else if(!strcmp(argv[i], "--liqdtorders")) size.liqdtorders = value;
+        else if(!strcmp(argv[i], "--iterations")) iterations = value;
+        else if(!strcmp(argv[i], "--seed")) size.seed = value;
+        else {
+            fprintf( stderr, "unknown option %s\n", argv[i] );
+            return 1;
+        }
+    }
+
+    const MemoryTables tables = synthetic::generate_market( size );
+    synthetic::load_chain( tables );
+    const ReserveSnapshot reserves( tables );
+    printf( "reserves=%zu collaterals=%zu loans=%zu liqdtorders=%zu iterations=%u\n\n",
+            tables.reserves.size(), tables.collaterals.size(), tables.loans.size(), tables.liqdtorders.size(), iterations );
+    printf( "%-48s %12s %8s %8s %8s %8s\n", "function", "ns/op", "tables", "lookups", "rows", "unpacked" );
+
+    vector<name> borrowers;
+    for(const auto& row: tables.cachedhealths) borrowers.push_back( row.account );
+    if(borrowers.empty()) {
+        fprintf( stderr, "no borrowers, increase --accounts\n" );
+        return 1;
+    }
+    const auto borrower = [&](const uint32_t i) { return borrowers[i % borrowers.size()]; };
+
+    // reserves of every borrower, as a bot tracking positions would know them
+    vector<vector<name>> borrower_pznames( borrowers.size() );
+    for(size_t i = 0; i < borrowers.size(); ++i) {
+        tables.for_each_collateral( borrowers[i], [&](const collateral_row& row){ borrower_pznames[i].push_back( row.pzname ); });
+        tables.for_each_loan( borrowers[i], [&](const loan_row& row){ borrower_pznames[i].push_back( row.pzname ); });
+    }
+
+    // `first` is resolved through the registry, `last` (scanned last in `pztoken` order) by scanning if it isn't registered
+    const auto& first = *reserves.by_pzname( get_pzkey( symbol_code{"USDT"} )->pzname );
+    const pztoken_row* last = &tables.reserves.back();
+    for(const auto& row: tables.reserves)
+        if(!get_pzkey( row.pzsymbol.get_symbol().code() )) last = &row;
+    const asset first_in { 10000, first.anchor.get_symbol() };
+    const asset last_in { 10000, last->anchor.get_symbol() };
+
+    measure( "ReserveSnapshot", iterations, [&](uint32_t) {
+        return ReserveSnapshot{}.rows.size();
+    });
+    measure( "get_amount_out (registry)", iterations, [&](uint32_t) {
+        return get_amount_out( first_in, first.pzsymbol.get_symbol() ).amount;
+    });
+    measure( "get_amount_out (scan)", iterations, [&](uint32_t) {
+        return get_amount_out( last_in, last->pzsymbol.get_symbol() ).amount;
+    });
+    measure( "get_amount_out (snapshot)", iterations, [&](uint32_t) {
+        return get_amount_out( last_in, last->pzsymbol.get_symbol(), reserves ).amount;
+    });
+    measure( "get_amount_in (registry)", iterations, [&](uint32_t) {
+        return get_amount_in( asset{ 10000, first.pzsymbol.get_symbol() }, first.anchor.get_symbol() ).in.amount;
+    });
+    measure( "get_health_factor", iterations, [&](uint32_t i) {
+        return get_health_factor( borrower(i) );
+    });
+    measure( "get_health_factor (snapshot)", iterations, [&](uint32_t i) {
+        return get_health_factor( borrower(i), reserves );
+    });
+    measure( "get_health_factor (cachedhealth, 600s)", iterations, [&](uint32_t i) {
+        return get_health_factor( borrower(i), 600, reserves ).factor;
+    });
+    measure( "get_health_factor (cachedhealth, 600s, pznames)", iterations, [&](uint32_t i) {
+        return get_health_factor( borrower(i), 600, reserves, borrower_pznames[i % borrowers.size()] ).factor;
+    });
+    measure( "get_collaterals + get_loans", iterations, [&](uint32_t i) {
+        return get_collaterals( borrower(i), reserves ).size() + get_loans( borrower(i), reserves ).size();
+    });
+    measure( "AccountPosition", iterations, [&](uint32_t i) {
+        return AccountPosition( borrower(i), reserves ).health_factor();
+    });
+
+    const uint32_t orders = std::max<uint32_t>( 1, std::min<uint32_t>( iterations, tables.liqdtorders.size() ) );
+    measure( "get_liquidation_out", orders, [&](uint32_t i) {
+        const auto& order = tables.liqdtorders[i % tables.liqdtorders.size()];
+        const auto loans = get_loans( order.account, reserves );
+        const auto collaterals = get_collaterals( order.account, reserves );
+        const auto& coll_res = *reserves.by_pzsymbol( order.collateral.quantity.symbol );
+        return get_liquidation_out( order.loan, coll_res.anchor, loans, collaterals ).quantity.amount;
+    });
+    measure( "get_best_liquidation", orders, [&](uint32_t i) {
+        const AccountPosition position( tables.liqdtorders[i % tables.liqdtorders.size()].account, reserves );
+        return get_best_liquidation( position ).profit;
+    });
+
+    const uint32_t scans = std::max<uint32_t>( 1, iterations / 100 );
+    measure( "get_liq_accounts", scans, [&](uint32_t) {
+        return get_liq_accounts( 10 ).size();
+    });
+    measure( "get_liq_accounts (snapshot)", scans, [&](uint32_t) {
+        return get_liq_accounts( 10, reserves ).size();
+    });
+    measure( "get_market_health (MemoryTables)", scans, [&](uint32_t) {
+        return get_market_health( tables, reserves, 1.0 ).below.size();
+    });
+    return 0;
+}
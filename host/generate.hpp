@@ -0,0 +1,191 @@
+#pragma once
+
+#include <random>
+
+#include "pizzalend.hpp"
+
+// Synthetic `lend.pizza` tables for the host benchmark and tests
+namespace pizzalend::synthetic {
+
+    struct MarketSize {
+        uint32_t    reserves = 8;           // known anchors first, then synthetic `TKA`, `TKB`...
+        uint32_t    accounts = 1000;
+        uint32_t    collaterals = 2;        // reserves deposited per account
+        uint32_t    loans = 1;              // reserves borrowed per borrower
+        double      borrowers = 0.5;        // share of accounts with loans
+        uint32_t    liqdtorders = 100;
+        uint64_t    time = 1'650'000'000;   // seconds since epoch
+        uint64_t    seed = 1;
+    };
+
+    struct AnchorInfo {
+        const char*     code;
+        uint8_t         precision;
+        name            contract;
+        int64_t         price;              // USD, 4 decimals
+    };
+
+    static constexpr AnchorInfo ANCHORS[] = {
+        { "USDT", 4, "tethertether"_n, 1'0000 },
+        { "EOS", 4, "eosio.token"_n, 3'5000 },
+        { "USN", 4, "danchortoken"_n, 1'0000 },
+        { "OUSD", 8, "core.ogx"_n, 1'0000 },
+        { "DFS", 4, "minedfstoken"_n, 21'3000 }
+    };
+
+    constexpr symbol PRICE_SYMBOL = symbol{ "USD", 4 };
+    constexpr symbol RATE_SYMBOL = symbol{ "X", 4 };
+
+    // "acct" followed by the base-31 digits of {i}
+    static name get_account( uint32_t i ) {
+        static const char* digits = "abcdefghijklmnopqrstuvwxyz12345";
+        std::string str = "acct";
+        for(int d = 0; d < 6; ++d, i /= 31) str += digits[i % 31];
+        return name{ str };
+    }
+
+    static asset get_rate( std::mt19937_64& rng, const double min, const double max ) {
+        return { static_cast<int64_t>(std::uniform_real_distribution<double>( min, max )( rng ) * 10000), RATE_SYMBOL };
+    }
+
+    static vector<pztoken_row> generate_reserves( const MarketSize& size, std::mt19937_64& rng ) {
+        vector<pztoken_row> rows;
+        for(uint32_t i = 0; i < size.reserves; ++i) {
+            AnchorInfo info { nullptr, 4, "token.host"_n, 0 };
+            std::string code = "TK";
+            if(i < std::size(ANCHORS)) {
+                info = ANCHORS[i];
+                code = info.code;
+            } else {
+                code += char('A' + (i - std::size(ANCHORS)) % 26);
+                if(i - std::size(ANCHORS) >= 26) code += char('A' + (i - std::size(ANCHORS)) / 26 % 26);
+                info.price = std::uniform_int_distribution<int64_t>( 1000, 500'0000 )( rng );
+            }
+            std::string pzname = "pz";
+            for(const char c: code) pzname += char(c - 'A' + 'a');
+
+            const symbol anchor_sym { code, info.precision };
+            const symbol pz_sym { "PZ" + code, info.precision };
+            const double pzprice = std::uniform_real_distribution<double>( 1.0, 1.3 )( rng );
+            const int64_t deposit = 10'000'000 * static_cast<int64_t>(POW10[info.precision]);
+            const int64_t borrow = deposit / 3;
+
+            pztoken_row row {};
+            row.pztoken = name{ pzname };
+            row.pzsymbol = { pz_sym, token_code };
+            row.anchor = { anchor_sym, info.contract };
+            row.cumulative_deposit = { deposit, anchor_sym };
+            row.available_deposit = { deposit - borrow, anchor_sym };
+            row.pzquantity = { static_cast<int64_t>(deposit / pzprice), pz_sym };
+            row.borrow = { borrow, anchor_sym };
+            row.cumulative_borrow = { borrow, anchor_sym };
+            row.variable_borrow = { borrow, anchor_sym };
+            row.stable_borrow = { 0, anchor_sym };
+            row.usage_rate = { 3333, RATE_SYMBOL };
+            row.floating_rate = get_rate( rng, 0.02, 0.15 );
+            row.discount_rate = get_rate( rng, 0.01, 0.05 );
+            row.price = { info.price, PRICE_SYMBOL };
+            row.pzprice = pzprice;
+            row.pzprice_rate = 0.01;
+            row.updated_at = size.time - std::uniform_int_distribution<uint64_t>( 0, 3600 )( rng );
+            row.config = {
+                { 200, RATE_SYMBOL }, { 3000, RATE_SYMBOL }, { 100, RATE_SYMBOL }, { 2000, RATE_SYMBOL },
+                { 8000, RATE_SYMBOL }, { 10, RATE_SYMBOL }, { 0, RATE_SYMBOL },
+                get_rate( rng, 0.7, 0.9 ), get_rate( rng, 0.05, 0.1 ), get_rate( rng, 0.6, 0.8 ), { 20000, RATE_SYMBOL },
+                true, i % 2 == 0, uint8_t(i % 4), uint8_t(i % 3)
+            };
+            rows.push_back( row );
+        }
+        return rows;
+    }
+
+    /**
+     * Reproducible market of {size} with a mix of healthy and liquidatable borrowers.
+     * Liquidation orders are opened against random borrowers, `cachedhealth` holds every borrower's health factor.
+     */
+    static MemoryTables generate_market( const MarketSize& size ) {
+        std::mt19937_64 rng( size.seed );
+        MemoryTables tables;
+        tables.time = size.time;
+        tables.reserves = generate_reserves( size, rng );
+        const ReserveSnapshot reserves( tables.reserves );
+        const auto& rows = reserves.rows;
+
+        uint64_t id = 0;
+        vector<name> borrowers;
+        const auto pick = [&](const uint32_t count) {
+            vector<uint32_t> picked;
+            while(picked.size() < std::min<size_t>(count, rows.size())) {
+                const uint32_t r = std::uniform_int_distribution<uint32_t>( 0, rows.size() - 1 )( rng );
+                if(std::find(picked.begin(), picked.end(), r) == picked.end()) picked.push_back( r );
+            }
+            return picked;
+        };
+        for(uint32_t a = 0; a < size.accounts; ++a) {
+            const name account = get_account( a );
+            int64_t ratioed = 0;
+            for(const uint32_t r: pick( size.collaterals )) {
+                const auto& reserve = rows[r];
+                const int64_t whole = std::uniform_int_distribution<int64_t>( 10, 10000 )( rng );
+                const asset quantity { whole * static_cast<int64_t>(POW10[reserve.pzsymbol.get_symbol().precision()]), reserve.pzsymbol.get_symbol() };
+                tables.collaterals.push_back({ id++, account, reserve.pztoken, quantity, size.time });
+                const auto tokens = unwrap( quantity, reserve, true );
+                ratioed += apply_rate( get_value( tokens.quantity, reserve.price ), reserve.config.liqdt_rate );
+            }
+            if(std::uniform_real_distribution<double>( 0, 1 )( rng ) >= size.borrowers) continue;
+
+            // loans worth 60% to 110% of the ratioed collateral, so some accounts can be liquidated
+            borrowers.push_back( account );
+            const auto loans = pick( size.loans );
+            for(const uint32_t r: loans) {
+                const auto& reserve = rows[r];
+                const symbol sym = reserve.anchor.get_symbol();
+                const double share = std::uniform_real_distribution<double>( 0.6, 1.1 )( rng ) / loans.size();
+                const int64_t amount = std::max<int64_t>( 1, get_amount( static_cast<int64_t>(ratioed * share), reserve.price, sym ) );
+                const bool stable = std::uniform_int_distribution<int>( 0, 4 )( rng ) == 0;
+                const uint64_t calculated_at = size.time - std::uniform_int_distribution<uint64_t>( 0, 30 * 24 * 3600 )( rng );
+                tables.loans.push_back({ id++, account, reserve.pztoken, { amount, sym }, { amount * 10000, sym }, uint8_t(stable ? 2 : 1),
+                                         stable ? get_rate( rng, 0.05, 0.2 ) : asset{ 0, RATE_SYMBOL }, 0, calculated_at, calculated_at });
+            }
+        }
+        tables.sort();
+
+        for(uint32_t i = 0; i < size.liqdtorders && !borrowers.empty(); ++i) {
+            const name account = borrowers[ std::uniform_int_distribution<size_t>( 0, borrowers.size() - 1 )( rng ) ];
+            const collateral_row* coll = nullptr;
+            const loan_row* loan = nullptr;
+            tables.for_each_collateral( account, [&](const collateral_row& row){ if(!coll) coll = &row; });
+            tables.for_each_loan( account, [&](const loan_row& row){ if(!loan) loan = &row; });
+            if(!coll || !loan) continue;
+            const auto& loan_res = *reserves.by_pzname( loan->pzname );
+            tables.liqdtorders.push_back({ i, account, { coll->quantity, token_code }, { loan->principal, loan_res.anchor.get_contract() }, 0, size.time });
+        }
+
+        for(const name account: borrowers) {
+            const AccountPosition position( account, reserves, tables );
+            const uint64_t age = std::uniform_int_distribution<uint64_t>( 0, 600 )( rng );
+            tables.cachedhealths.push_back({ account, position.loan_value, position.ratioed_value, position.health_factor(), size.time - age });
+        }
+        tables.sort();
+        return tables;
+    }
+
+    // load {tables} into the host `multi_index` database read by `ChainTables`, with `pztken.pizza` supplies of every pz-token
+    static void load_chain( const MemoryTables& tables ) {
+        pztoken pztoken_tbl( code, code.value );
+        for(const auto& row: tables.reserves) {
+            pztoken_tbl.emplace( code, [&](auto& r){ r = row; });
+            utils::stats stats( token_code, row.pzsymbol.get_symbol().code().raw() );
+            stats.emplace( code, [&](auto& r){ r = { row.pzquantity, { std::numeric_limits<int64_t>::max() / 2, row.pzsymbol.get_symbol() }, code }; });
+        }
+        collateral_table collateral_tbl( code, code.value );
+        for(const auto& row: tables.collaterals) collateral_tbl.emplace( code, [&](auto& r){ r = row; });
+        loan_table loan_tbl( code, code.value );
+        for(const auto& row: tables.loans) loan_tbl.emplace( code, [&](auto& r){ r = row; });
+        liqdtorder liqdtordertbl( code, code.value );
+        for(const auto& row: tables.liqdtorders) liqdtordertbl.emplace( code, [&](auto& r){ r = row; });
+        cachedhealth_table cachedhealth_tbl( code, code.value );
+        for(const auto& row: tables.cachedhealths) cachedhealth_tbl.emplace( code, [&](auto& r){ r = row; });
+        eosio::host::time = tables.time;
+    }
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <eosio/check.hpp>
+#include <eosio/symbol.hpp>
+#include <eosio/serialize.hpp>
+
+namespace eosio {
+
+    struct asset {
+        int64_t         amount = 0;
+        eosio::symbol   symbol;
+
+        asset() = default;
+        asset( const int64_t amount, const eosio::symbol sym ): amount( amount ), symbol( sym ) {}
+
+        bool is_valid() const { return symbol.is_valid(); }
+
+        std::string to_string() const {
+            const uint8_t precision = symbol.precision();
+            const bool negative = amount < 0;
+            const uint64_t abs = negative ? -static_cast<uint64_t>(amount) : amount;
+            std::string digits = std::to_string( abs );
+            if(precision) {
+                if(digits.size() <= precision) digits.insert( 0, precision + 1 - digits.size(), '0' );
+                digits.insert( digits.size() - precision, "." );
+            }
+            return (negative ? "-" : "") + digits + " " + symbol.code().to_string();
+        }
+
+        asset operator-() const { return { -amount, symbol }; }
+
+        asset& operator+=( const asset& a ) {
+            check( a.symbol == symbol, "attempt to add asset with different symbol" );
+            amount += a.amount;
+            return *this;
+        }
+
+        asset& operator-=( const asset& a ) {
+            check( a.symbol == symbol, "attempt to subtract asset with different symbol" );
+            amount -= a.amount;
+            return *this;
+        }
+
+        friend asset operator+( asset a, const asset& b ) { return a += b; }
+        friend asset operator-( asset a, const asset& b ) { return a -= b; }
+
+        friend bool operator==( const asset& a, const asset& b ) {
+            check( a.symbol == b.symbol, "comparison of assets with different symbols is not allowed" );
+            return a.amount == b.amount;
+        }
+
+        friend bool operator<( const asset& a, const asset& b ) {
+            check( a.symbol == b.symbol, "comparison of assets with different symbols is not allowed" );
+            return a.amount < b.amount;
+        }
+
+        friend bool operator!=( const asset& a, const asset& b ) { return !(a == b); }
+        friend bool operator<=( const asset& a, const asset& b ) { return !(b < a); }
+        friend bool operator>( const asset& a, const asset& b ) { return b < a; }
+        friend bool operator>=( const asset& a, const asset& b ) { return !(a < b); }
+    };
+
+    struct extended_asset {
+        asset   quantity;
+        name    contract;
+
+        extended_asset() = default;
+        extended_asset( const int64_t amount, const extended_symbol s ): quantity( amount, s.get_symbol() ), contract( s.get_contract() ) {}
+        extended_asset( const asset a, const name c ): quantity( a ), contract( c ) {}
+
+        extended_symbol get_extended_symbol() const { return { quantity.symbol, contract }; }
+
+        std::string to_string() const {
+            return quantity.to_string() + "@" + contract.to_string();
+        }
+
+        friend bool operator==( const extended_asset& a, const extended_asset& b ) {
+            return a.contract == b.contract && a.quantity == b.quantity;
+        }
+
+        friend bool operator<( const extended_asset& a, const extended_asset& b ) {
+            check( a.contract == b.contract, "type mismatch" );
+            return a.quantity < b.quantity;
+        }
+
+        friend bool operator!=( const extended_asset& a, const extended_asset& b ) { return !(a == b); }
+        friend bool operator<=( const extended_asset& a, const extended_asset& b ) { return !(b < a); }
+        friend bool operator>( const extended_asset& a, const extended_asset& b ) { return b < a; }
+        friend bool operator>=( const extended_asset& a, const extended_asset& b ) { return !(a < b); }
+    };
+
+    inline std::ostream& operator<<( std::ostream& out, const asset& a ) { return out << a.to_string(); }
+    inline std::ostream& operator<<( std::ostream& out, const extended_asset& a ) { return out << a.to_string(); }
+    inline std::ostream& operator<<( std::ostream& out, const extended_symbol& s ) { return out << s.to_string(); }
+    inline std::ostream& operator<<( std::ostream& out, const symbol& s ) { return out << s.to_string(); }
+
+    // serialized the same way as on chain
+    inline void pack_to( std::vector<char>& out, const asset& a ) { pack_to( out, a.amount ); pack_to( out, a.symbol ); }
+    inline void pack_to( std::vector<char>& out, const extended_asset& a ) { pack_to( out, a.quantity ); pack_to( out, a.contract ); }
+    inline void unpack_from( datastream& ds, asset& a ) { unpack_from( ds, a.amount ); unpack_from( ds, a.symbol ); }
+    inline void unpack_from( datastream& ds, extended_asset& a ) { unpack_from( ds, a.quantity ); unpack_from( ds, a.contract ); }
+}
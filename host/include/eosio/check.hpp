@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+
+// Host stand-in for the CDT headers used by `pizzalend.hpp` (native builds only)
+namespace eosio {
+
+    // failed checks throw instead of aborting the transaction, so tests can expect them
+    struct check_failure : std::runtime_error {
+        using std::runtime_error::runtime_error;
+    };
+
+    inline void check( const bool pred, const char* msg ) {
+        if(!pred) throw check_failure( msg );
+    }
+
+    inline void check( const bool pred, const std::string& msg ) {
+        if(!pred) throw check_failure( msg );
+    }
+}
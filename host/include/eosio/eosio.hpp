@@ -0,0 +1,6 @@
+#pragma once
+
+#include <eosio/asset.hpp>
+#include <eosio/multi_index.hpp>
+#include <eosio/print.hpp>
+#include <eosio/system.hpp>
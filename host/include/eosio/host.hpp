@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+
+// State of the host stand-in shared by the intrinsics: table read counters and block time
+namespace eosio::host {
+
+    struct counters {
+        uint64_t    tables = 0;         // multi_index constructions
+        uint64_t    lookups = 0;        // primary and secondary find / lower_bound calls
+        uint64_t    rows = 0;           // rows read from the database (whole or partial)
+        uint64_t    unpacked = 0;       // rows deserialized with `unpack`
+    };
+
+    inline counters count;
+
+    // seconds since epoch returned by `current_time_point()`
+    inline uint64_t time = 0;
+}
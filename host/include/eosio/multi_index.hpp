@@ -0,0 +1,275 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <set>
+#include <tuple>
+
+#include <eosio/asset.hpp>
+#include <eosio/host.hpp>
+
+namespace eosio {
+
+    namespace host {
+        // rows of one (code, scope, table) in serialized form, with the secondary keys of every index
+        struct table {
+            std::map<uint64_t, std::vector<char>>                           rows;       // by primary key
+            std::map<uint64_t, std::set<std::pair<uint128_t, uint64_t>>>    indexes;    // index name => (key, primary)
+        };
+
+        struct database {
+            std::map<std::tuple<uint64_t, uint64_t, uint64_t>, table>   tables;
+            std::vector<std::pair<const table*, uint64_t>>              iterators;  // handle => (table, primary)
+            std::map<std::pair<const table*, uint64_t>, int32_t>        handles;
+        };
+
+        inline database db;
+
+        // drop all tables and reset counters and time
+        inline void reset() {
+            db = {};
+            count = {};
+            time = 0;
+        }
+
+        inline table& get_table( const uint64_t code, const uint64_t scope, const uint64_t table_name ) {
+            return db.tables[{ code, scope, table_name }];
+        }
+
+        inline const table* find_table( const uint64_t code, const uint64_t scope, const uint64_t table_name ) {
+            const auto it = db.tables.find({ code, scope, table_name });
+            return it == db.tables.end() ? nullptr : &it->second;
+        }
+
+        // iterator handle of a row (end iterator is -1)
+        inline int32_t get_handle( const table* tbl, const uint64_t primary ) {
+            const auto [ it, inserted ] = db.handles.try_emplace({ tbl, primary }, int32_t(db.iterators.size()));
+            if(inserted) db.iterators.push_back({ tbl, primary });
+            return it->second;
+        }
+
+        inline const std::vector<char>* get_row( const int32_t itr ) {
+            check( itr >= 0 && size_t(itr) < db.iterators.size(), "invalid iterator" );
+            const auto [ tbl, primary ] = db.iterators[itr];
+            const auto it = tbl->rows.find( primary );
+            return it == tbl->rows.end() ? nullptr : &it->second;
+        }
+    }
+
+    // database intrinsics used directly by `pztoken_view`
+    namespace internal_use_do_not_use {
+        inline int32_t db_find_i64( const uint64_t code, const uint64_t scope, const uint64_t table, const uint64_t id ) {
+            ++host::count.lookups;
+            const auto tbl = host::find_table( code, scope, table );
+            if(!tbl || !tbl->rows.count( id )) return -1;
+            return host::get_handle( tbl, id );
+        }
+
+        inline int32_t db_lowerbound_i64( const uint64_t code, const uint64_t scope, const uint64_t table, const uint64_t id ) {
+            ++host::count.lookups;
+            const auto tbl = host::find_table( code, scope, table );
+            if(!tbl) return -1;
+            const auto it = tbl->rows.lower_bound( id );
+            return it == tbl->rows.end() ? -1 : host::get_handle( tbl, it->first );
+        }
+
+        inline int32_t db_next_i64( const int32_t itr, uint64_t* primary ) {
+            check( itr >= 0, "cannot increment end iterator" );
+            const auto [ tbl, key ] = host::db.iterators[itr];
+            const auto it = tbl->rows.upper_bound( key );
+            if(it == tbl->rows.end()) return -1;
+            *primary = it->first;
+            return host::get_handle( tbl, it->first );
+        }
+
+        // copies up to {len} bytes of the row, returns the row size ({len} == 0 only queries the size)
+        inline int32_t db_get_i64( const int32_t itr, void* data, const uint32_t len ) {
+            const auto row = host::get_row( itr );
+            check( row != nullptr, "row was removed" );
+            if(len == 0) return row->size();
+            ++host::count.rows;
+            memcpy( data, row->data(), std::min<size_t>( len, row->size() ) );
+            return row->size();
+        }
+    }
+
+    template <typename Class, typename Type, Type (Class::*PtrToMemberFunction)() const>
+    struct const_mem_fun {
+        using result_type = Type;
+        Type operator()( const Class& c ) const { return (c.*PtrToMemberFunction)(); }
+    };
+
+    template <name IndexName, typename Extractor>
+    struct indexed_by {
+        static constexpr name index_name = IndexName;
+        using extractor = Extractor;
+    };
+
+    /**
+     * In-memory `multi_index`: rows are stored serialized in `host::db` and deserialized on first access
+     * (cached per table object, as in CDT), so table reads and deserializations are counted like on chain.
+     */
+    template <name TableName, typename T, typename... Indices>
+    class multi_index {
+    public:
+        multi_index( const name code, const uint64_t scope ): code( code ), scope( scope ) {
+            ++host::count.tables;
+        }
+
+        class const_iterator {
+        public:
+            const_iterator() = default;
+            const_iterator( const multi_index* table, const int32_t itr, const uint64_t primary ): table( table ), itr( itr ), primary( primary ) {}
+
+            const T& operator*() const { return table->load( itr, primary ); }
+            const T* operator->() const { return &**this; }
+
+            const_iterator& operator++() {
+                itr = internal_use_do_not_use::db_next_i64( itr, &primary );
+                return *this;
+            }
+
+            friend bool operator==( const const_iterator& a, const const_iterator& b ) {
+                return a.itr < 0 ? b.itr < 0 : a.itr == b.itr;
+            }
+
+        private:
+            const multi_index*  table = nullptr;
+            int32_t             itr = -1;
+            uint64_t            primary = 0;
+        };
+
+        template <typename Index>
+        class index {
+        public:
+            using key_set = std::set<std::pair<uint128_t, uint64_t>>;
+
+            class const_iterator {
+            public:
+                const_iterator( const multi_index* table, typename key_set::const_iterator it ): table( table ), it( it ) {}
+
+                // the row is looked up by primary key once per position, as CDT iterators keep the loaded item
+                const T& operator*() const {
+                    if(!item) item = &*table->find( it->second );
+                    return *item;
+                }
+                const T* operator->() const { return &**this; }
+                const_iterator& operator++() { ++it; item = nullptr; return *this; }
+                friend bool operator==( const const_iterator& a, const const_iterator& b ) { return a.it == b.it; }
+
+            private:
+                const multi_index*                  table;
+                typename key_set::const_iterator    it;
+                mutable const T*                    item = nullptr;
+            };
+
+            explicit index( const multi_index* table ): table( table ), keys( &table->get_keys( Index::index_name ) ) {}
+
+            const_iterator begin() const { return { table, keys->begin() }; }
+            const_iterator end() const { return { table, keys->end() }; }
+
+            const_iterator lower_bound( const uint128_t key ) const {
+                ++host::count.lookups;
+                return { table, keys->lower_bound({ key, 0 }) };
+            }
+
+        private:
+            const multi_index*  table;
+            const key_set*      keys;
+        };
+
+        const_iterator begin() const { return lower_bound( 0 ); }
+        const_iterator end() const { return {}; }
+
+        const_iterator lower_bound( const uint64_t primary ) const {
+            const int32_t itr = internal_use_do_not_use::db_lowerbound_i64( code.value, scope, TableName.value, primary );
+            return { this, itr, itr < 0 ? 0 : host::db.iterators[itr].second };
+        }
+
+        const_iterator find( const uint64_t primary ) const {
+            return { this, internal_use_do_not_use::db_find_i64( code.value, scope, TableName.value, primary ), primary };
+        }
+
+        const T& get( const uint64_t primary, const char* error_msg = "unable to find key" ) const {
+            const auto it = find( primary );
+            check( it != end(), error_msg );
+            return *it;
+        }
+
+        template <name IndexName>
+        auto get_index() const {
+            return index<find_index<IndexName, Indices...>>( this );
+        }
+
+        template <typename F>
+        const_iterator emplace( const name, F&& constructor ) {
+            T row {};
+            constructor( row );
+            const uint64_t primary = row.primary_key();
+            auto& tbl = host::get_table( code.value, scope, TableName.value );
+            check( !tbl.rows.count( primary ), "could not insert object, most likely a uniqueness constraint was violated" );
+            tbl.rows[primary] = pack( row );
+            (tbl.indexes[Indices::index_name.value].insert({ typename Indices::extractor{}( row ), primary }), ...);
+            return find( primary );
+        }
+
+        template <typename F>
+        void modify( const const_iterator& it, const name, F&& updater ) {
+            T row = *it;
+            const uint64_t primary = row.primary_key();
+            auto& tbl = host::get_table( code.value, scope, TableName.value );
+            (tbl.indexes[Indices::index_name.value].erase({ typename Indices::extractor{}( row ), primary }), ...);
+            updater( row );
+            check( row.primary_key() == primary, "updater cannot change primary key when modifying an object" );
+            tbl.rows[primary] = pack( row );
+            (tbl.indexes[Indices::index_name.value].insert({ typename Indices::extractor{}( row ), primary }), ...);
+            cache.erase( primary );
+        }
+
+        void erase( const const_iterator& it ) {
+            const T row = *it;
+            const uint64_t primary = row.primary_key();
+            auto& tbl = host::get_table( code.value, scope, TableName.value );
+            (tbl.indexes[Indices::index_name.value].erase({ typename Indices::extractor{}( row ), primary }), ...);
+            tbl.rows.erase( primary );
+            cache.erase( primary );
+        }
+
+    private:
+        name                                                code;
+        uint64_t                                            scope;
+        mutable std::map<uint64_t, std::unique_ptr<T>>      cache;
+
+        template <name IndexName, typename Index, typename... Rest>
+        static auto find_index_impl() {
+            if constexpr (Index::index_name == IndexName) return Index{};
+            else {
+                static_assert( sizeof...(Rest) > 0, "eosio: unknown index" );
+                return find_index_impl<IndexName, Rest...>();
+            }
+        }
+
+        template <name IndexName, typename... Index>
+        using find_index = decltype(find_index_impl<IndexName, Index...>());
+
+        const std::set<std::pair<uint128_t, uint64_t>>& get_keys( const name index_name ) const {
+            static const std::set<std::pair<uint128_t, uint64_t>> empty;
+            const auto tbl = host::find_table( code.value, scope, TableName.value );
+            if(!tbl) return empty;
+            const auto it = tbl->indexes.find( index_name.value );
+            return it == tbl->indexes.end() ? empty : it->second;
+        }
+
+        const T& load( const int32_t itr, const uint64_t primary ) const {
+            check( itr >= 0, "cannot dereference end iterator" );
+            auto& row = cache[primary];
+            if(!row) {
+                const uint32_t size = internal_use_do_not_use::db_get_i64( itr, nullptr, 0 );
+                std::vector<char> bytes( size );
+                internal_use_do_not_use::db_get_i64( itr, bytes.data(), size );
+                row = std::make_unique<T>( unpack<T>( bytes.data(), size ) );
+            }
+            return *row;
+        }
+    };
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <compare>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+typedef __uint128_t uint128_t;
+typedef __int128 int128_t;
+
+namespace eosio {
+
+    // same 64-bit encoding as CDT `eosio::name`
+    struct name {
+        uint64_t value = 0;
+
+        constexpr name() = default;
+        constexpr explicit name( const uint64_t v ): value( v ) {}
+
+        constexpr explicit name( const std::string_view str ) {
+            const uint32_t n = str.size() < 12 ? str.size() : 12;
+            for(uint32_t i = 0; i < n; ++i) {
+                value <<= 5;
+                value |= char_to_value( str[i] );
+            }
+            value <<= 4 + 5 * (12 - n);
+            if(str.size() == 13) value |= char_to_value( str[12] ) & 0x0f;
+        }
+
+        static constexpr uint8_t char_to_value( const char c ) {
+            if(c == '.') return 0;
+            if(c >= '1' && c <= '5') return (c - '1') + 1;
+            if(c >= 'a' && c <= 'z') return (c - 'a') + 6;
+            return 0;
+        }
+
+        std::string to_string() const {
+            static const char* charmap = ".12345abcdefghijklmnopqrstuvwxyz";
+            std::string str( 13, '.' );
+            uint64_t tmp = value;
+            for(uint32_t i = 0; i <= 12; ++i) {
+                str[12 - i] = charmap[tmp & (i == 0 ? 0x0f : 0x1f)];
+                tmp >>= (i == 0 ? 4 : 5);
+            }
+            while(!str.empty() && str.back() == '.') str.pop_back();
+            return str;
+        }
+
+        constexpr explicit operator bool() const { return value != 0; }
+
+        friend constexpr bool operator==( const name&, const name& ) = default;
+        friend constexpr auto operator<=>( const name&, const name& ) = default;
+    };
+
+    inline std::ostream& operator<<( std::ostream& out, const name& n ) {
+        return out << n.to_string();
+    }
+
+    inline namespace literals {
+        constexpr name operator""_n( const char* str, const std::size_t size ) {
+            return name{ std::string_view{ str, size } };
+        }
+    }
+}
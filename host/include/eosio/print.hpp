@@ -0,0 +1,14 @@
+#pragma once
+
+#include <iostream>
+
+#include <eosio/asset.hpp>
+
+namespace eosio {
+
+    // console output goes to stdout
+    template <typename... Args>
+    void print( Args&&... args ) {
+        (std::cout << ... << args);
+    }
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include <eosio/check.hpp>
+#include <eosio/host.hpp>
+#include <eosio/symbol.hpp>
+
+namespace eosio {
+
+    // read position in a serialized row
+    struct datastream {
+        const char*     pos;
+        const char*     end;
+
+        void read( void* data, const size_t size ) {
+            check( size <= size_t(end - pos), "datastream attempted to read past the end" );
+            memcpy( data, pos, size );
+            pos += size;
+        }
+    };
+
+    namespace reflect {
+        struct any_field {
+            template <typename T> constexpr operator T&() const &&;
+        };
+
+        // number of fields of an aggregate
+        template <typename T, typename... Fields>
+        constexpr size_t field_count() {
+            if constexpr (requires { T{ Fields{}..., any_field{} }; }) return field_count<T, Fields..., any_field>();
+            else return sizeof...(Fields);
+        }
+
+        // calls {f} with every field of aggregate {t} in declaration order (tables here have at most 20 fields)
+        template <typename T, typename F>
+        void for_each_field( T& t, F&& f ) {
+            constexpr size_t n = field_count<std::remove_cv_t<T>>();
+            static_assert( n > 0 && n <= 20, "eosio: unsupported number of fields" );
+        if constexpr(n == 1) { auto& [ f0 ] = t; ( f( f0 ) ); }
+        else if constexpr(n == 2) { auto& [ f0, f1 ] = t; ( f( f0 ), f( f1 ) ); }
+        else if constexpr(n == 3) { auto& [ f0, f1, f2 ] = t; ( f( f0 ), f( f1 ), f( f2 ) ); }
+        else if constexpr(n == 4) { auto& [ f0, f1, f2, f3 ] = t; ( f( f0 ), f( f1 ), f( f2 ), f( f3 ) ); }
+        else if constexpr(n == 5) { auto& [ f0, f1, f2, f3, f4 ] = t; ( f( f0 ), f( f1 ), f( f2 ), f( f3 ), f( f4 ) ); }
+        else if constexpr(n == 6) { auto& [ f0, f1, f2, f3, f4, f5 ] = t; ( f( f0 ), f( f1 ), f( f2 ), f( f3 ), f( f4 ), f( f5 ) ); }
+        else if constexpr(n == 7) { auto& [ f0, f1, f2, f3, f4, f5, f6 ] = t; ( f( f0 ), f( f1 ), f( f2 ), f( f3 ), f( f4 ), f( f5 ), f( f6 ) ); }
+        else if constexpr(n == 8) { auto& [ f0, f1, f2, f3, f4, f5, f6, f7 ] = t; ( f( f0 ), f( f1 ), f( f2 ), f( f3 ), f( f4 ), f( f5 ), f( f6 ), f( f7 ) ); }
+        else if constexpr(n == 9) { auto& [ f0, f1, f2, f3, f4, f5, f6, f7, f8 ] = t; ( f( f0 ), f( f1 ), f( f2 ), f( f3 ), f( f4 ), f( f5 ), f( f6 ), f( f7 ), f( f8 ) ); }
+        else if constexpr(n == 10) { auto& [ f0, f1, f2, f3, f4, f5, f6, f7, f8, f9 ] = t; ( f( f0 ), f( f1 ), f( f2 ), f( f3 ), f( f4 ), f( f5 ), f( f6 ), f( f7 ), f( f8 ), f( f9 ) ); }
+        else if constexpr(n == 11) { auto& [ f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10 ] = t; ( f( f0 ), f( f1 ), f( f2 ), f( f3 ), f( f4 ), f( f5 ), f( f6 ), f( f7 ), f( f8 ), f( f9 ), f( f10 ) ); }
+        else if constexpr(n == 12) { auto& [ f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11 ] = t; ( f( f0 ), f( f1 ), f( f2 ), f( f3 ), f( f4 ), f( f5 ), f( f6 ), f( f7 ), f( f8 ), f( f9 ), f( f10 ), f( f11 ) ); }
+        else if constexpr(n == 13) { auto& [ f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12 ] = t; ( f( f0 ), f( f1 ), f( f2 ), f( f3 ), f( f4 ), f( f5 ), f( f6 ), f( f7 ), f( f8 ), f( f9 ), f( f10 ), f( f11 ), f( f12 ) ); }
+        else if constexpr(n == 14) { auto& [ f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13 ] = t; ( f( f0 ), f( f1 ), f( f2 ), f( f3 ), f( f4 ), f( f5 ), f( f6 ), f( f7 ), f( f8 ), f( f9 ), f( f10 ), f( f11 ), f( f12 ), f( f13 ) ); }
+        else if constexpr(n == 15) { auto& [ f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14 ] = t; ( f( f0 ), f( f1 ), f( f2 ), f( f3 ), f( f4 ), f( f5 ), f( f6 ), f( f7 ), f( f8 ), f( f9 ), f( f10 ), f( f11 ), f( f12 ), f( f13 ), f( f14 ) ); }
+        else if constexpr(n == 16) { auto& [ f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15 ] = t; ( f( f0 ), f( f1 ), f( f2 ), f( f3 ), f( f4 ), f( f5 ), f( f6 ), f( f7 ), f( f8 ), f( f9 ), f( f10 ), f( f11 ), f( f12 ), f( f13 ), f( f14 ), f( f15 ) ); }
+        else if constexpr(n == 17) { auto& [ f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16 ] = t; ( f( f0 ), f( f1 ), f( f2 ), f( f3 ), f( f4 ), f( f5 ), f( f6 ), f( f7 ), f( f8 ), f( f9 ), f( f10 ), f( f11 ), f( f12 ), f( f13 ), f( f14 ), f( f15 ), f( f16 ) ); }
+        else if constexpr(n == 18) { auto& [ f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17 ] = t; ( f( f0 ), f( f1 ), f( f2 ), f( f3 ), f( f4 ), f( f5 ), f( f6 ), f( f7 ), f( f8 ), f( f9 ), f( f10 ), f( f11 ), f( f12 ), f( f13 ), f( f14 ), f( f15 ), f( f16 ), f( f17 ) ); }
+        else if constexpr(n == 19) { auto& [ f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18 ] = t; ( f( f0 ), f( f1 ), f( f2 ), f( f3 ), f( f4 ), f( f5 ), f( f6 ), f( f7 ), f( f8 ), f( f9 ), f( f10 ), f( f11 ), f( f12 ), f( f13 ), f( f14 ), f( f15 ), f( f16 ), f( f17 ), f( f18 ) ); }
+        else if constexpr(n == 20) { auto& [ f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19 ] = t; ( f( f0 ), f( f1 ), f( f2 ), f( f3 ), f( f4 ), f( f5 ), f( f6 ), f( f7 ), f( f8 ), f( f9 ), f( f10 ), f( f11 ), f( f12 ), f( f13 ), f( f14 ), f( f15 ), f( f16 ), f( f17 ), f( f18 ), f( f19 ) ); }
+        }
+    }
+
+    template <typename T> requires std::is_arithmetic_v<T>
+    void pack_to( std::vector<char>& out, const T& value ) {
+        const char* bytes = reinterpret_cast<const char*>(&value);
+        out.insert( out.end(), bytes, bytes + sizeof(T) );
+    }
+
+    template <typename T> requires std::is_arithmetic_v<T>
+    void unpack_from( datastream& ds, T& value ) {
+        ds.read( &value, sizeof(T) );
+    }
+
+    inline void pack_to( std::vector<char>& out, const name& n ) { pack_to( out, n.value ); }
+    inline void pack_to( std::vector<char>& out, const symbol_code& sc ) { pack_to( out, sc.raw() ); }
+    inline void pack_to( std::vector<char>& out, const symbol& sym ) { pack_to( out, sym.raw() ); }
+    inline void pack_to( std::vector<char>& out, const extended_symbol& s ) { pack_to( out, s.get_symbol() ); pack_to( out, s.get_contract() ); }
+
+    inline void unpack_from( datastream& ds, name& n ) { unpack_from( ds, n.value ); }
+    inline void unpack_from( datastream& ds, symbol_code& sc ) { uint64_t raw; unpack_from( ds, raw ); sc = symbol_code{ raw }; }
+    inline void unpack_from( datastream& ds, symbol& sym ) { uint64_t raw; unpack_from( ds, raw ); sym = symbol{ raw }; }
+    inline void unpack_from( datastream& ds, extended_symbol& s ) {
+        symbol sym;
+        name contract;
+        unpack_from( ds, sym );
+        unpack_from( ds, contract );
+        s = { sym, contract };
+    }
+
+    // table rows and their nested structs are serialized field by field, like `EOSLIB_SERIALIZE`
+    template <typename T> requires std::is_aggregate_v<T>
+    void pack_to( std::vector<char>& out, const T& value ) {
+        reflect::for_each_field( value, [&](const auto& field) { pack_to( out, field ); } );
+    }
+
+    template <typename T> requires std::is_aggregate_v<T>
+    void unpack_from( datastream& ds, T& value ) {
+        reflect::for_each_field( value, [&](auto& field) { unpack_from( ds, field ); } );
+    }
+
+    template <typename T>
+    std::vector<char> pack( const T& value ) {
+        std::vector<char> out;
+        pack_to( out, value );
+        return out;
+    }
+
+    template <typename T>
+    T unpack( const char* buffer, const size_t size ) {
+        ++host::count.unpacked;
+        T value {};
+        datastream ds { buffer, buffer + size };
+        unpack_from( ds, value );
+        return value;
+    }
+}
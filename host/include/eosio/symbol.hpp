@@ -0,0 +1,105 @@
+#pragma once
+
+#include <eosio/name.hpp>
+
+namespace eosio {
+
+    // up to 7 uppercase characters, first character in the lowest byte (same as CDT)
+    class symbol_code {
+    public:
+        constexpr symbol_code() = default;
+        constexpr explicit symbol_code( const uint64_t raw ): value( raw ) {}
+
+        constexpr explicit symbol_code( const std::string_view str ) {
+            for(auto i = str.size(); i > 0; --i) {
+                value <<= 8;
+                value |= static_cast<uint8_t>(str[i - 1]);
+            }
+        }
+
+        constexpr uint64_t raw() const { return value; }
+
+        constexpr uint32_t length() const {
+            uint64_t sym = value;
+            uint32_t len = 0;
+            while(sym & 0xff && len <= 7) {
+                ++len;
+                sym >>= 8;
+            }
+            return len;
+        }
+
+        constexpr bool is_valid() const {
+            uint64_t sym = value;
+            for(int i = 0; i < 7; ++i) {
+                const char c = sym & 0xff;
+                if(!('A' <= c && c <= 'Z')) return false;
+                sym >>= 8;
+                if(!(sym & 0xff)) {
+                    do {
+                        sym >>= 8;
+                        if(sym & 0xff) return false;
+                    } while(++i < 7);
+                }
+            }
+            return true;
+        }
+
+        std::string to_string() const {
+            std::string str;
+            for(uint64_t sym = value; sym & 0xff; sym >>= 8) str += static_cast<char>(sym & 0xff);
+            return str;
+        }
+
+        friend constexpr bool operator==( const symbol_code&, const symbol_code& ) = default;
+        friend constexpr auto operator<=>( const symbol_code&, const symbol_code& ) = default;
+
+    private:
+        uint64_t value = 0;
+    };
+
+    class symbol {
+    public:
+        constexpr symbol() = default;
+        constexpr explicit symbol( const uint64_t raw ): value( raw ) {}
+        constexpr symbol( const symbol_code sc, const uint8_t precision ): value( sc.raw() << 8 | precision ) {}
+        constexpr symbol( const std::string_view ss, const uint8_t precision ): symbol( symbol_code{ ss }, precision ) {}
+
+        constexpr uint64_t raw() const { return value; }
+        constexpr uint8_t precision() const { return value & 0xff; }
+        constexpr symbol_code code() const { return symbol_code{ value >> 8 }; }
+        constexpr bool is_valid() const { return code().is_valid(); }
+
+        constexpr explicit operator bool() const { return value != 0; }
+
+        std::string to_string() const {
+            return std::to_string( precision() ) + "," + code().to_string();
+        }
+
+        friend constexpr bool operator==( const symbol&, const symbol& ) = default;
+        friend constexpr auto operator<=>( const symbol&, const symbol& ) = default;
+
+    private:
+        uint64_t value = 0;
+    };
+
+    class extended_symbol {
+    public:
+        constexpr extended_symbol() = default;
+        constexpr extended_symbol( const symbol sym, const name contract ): sym( sym ), contract( contract ) {}
+
+        constexpr symbol get_symbol() const { return sym; }
+        constexpr name get_contract() const { return contract; }
+
+        std::string to_string() const {
+            return sym.to_string() + "@" + contract.to_string();
+        }
+
+        friend constexpr bool operator==( const extended_symbol&, const extended_symbol& ) = default;
+        friend constexpr auto operator<=>( const extended_symbol&, const extended_symbol& ) = default;
+
+    private:
+        symbol  sym;
+        name    contract;
+    };
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <eosio/host.hpp>
+
+namespace eosio {
+
+    struct time_point {
+        int64_t     us = 0;
+
+        uint32_t sec_since_epoch() const { return us / 1'000'000; }
+    };
+
+    // block time, set through `host::time`
+    inline time_point current_time_point() {
+        return { static_cast<int64_t>(host::time) * 1'000'000 };
+    }
+}
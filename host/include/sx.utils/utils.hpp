@@ -0,0 +1,47 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <eosio/eosio.hpp>
+
+// Host stand-in for the parts of `sx.utils` used by `pizzalend.hpp`
+namespace sx {
+
+    using eosio::asset;
+    using eosio::extended_asset;
+    using eosio::extended_symbol;
+    using eosio::name;
+    using std::map;
+    using std::pair;
+    using std::string;
+    using std::vector;
+
+    struct OraclizedAsset {
+        extended_asset  tokens;
+        double          value;
+        double          ratioed;
+    };
+
+namespace utils {
+
+    struct [[eosio::table]] currency_stats {
+        asset       supply;
+        asset       max_supply;
+        name        issuer;
+
+        uint64_t primary_key() const { return supply.symbol.code().raw(); }
+    };
+    typedef eosio::multi_index< eosio::name{"stat"}, currency_stats > stats;
+
+    // token supply from the `stat` table of the token contract (empty asset if the token doesn't exist)
+    static asset get_supply( const extended_symbol ext_sym ) {
+        const stats statstable( ext_sym.get_contract(), ext_sym.get_symbol().code().raw() );
+        const auto it = statstable.find( ext_sym.get_symbol().code().raw() );
+        return it == statstable.end() ? asset{} : it->supply;
+    }
+}
+}
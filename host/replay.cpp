@@ -0,0 +1,61 @@
+// Replay tool: runs a liquidation policy over a replay stream starting from a snapshot and prints per-block stats
+//
+// usage: pizzalend_replay <snapshot> <stream> [--min-value N] [--min-profit N] [--any-order 1] [--quiet 1]
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "replay.hpp"
+
+using namespace pizzalend;
+
+int main( int argc, char** argv )
+{
+    if(argc < 3) {
+        fprintf( stderr, "usage: %s <snapshot> <stream> [--min-value N] [--min-profit N] [--any-order 1] [--quiet 1]\n", argv[0] );
+        return 1;
+    }
+    LiquidationPolicy policy;
+    bool quiet = false;
+    for(int i = 3; i + 1 < argc; i += 2) {
+        const double value = std::strtod( argv[i + 1], nullptr );
+        if(!strcmp(argv[i], "--min-value")) policy.min_value = value;
+        else if(!strcmp(argv[i], "--min-profit")) policy.min_profit = value;
+        else if(!strcmp(argv[i], "--any-order")) policy.respect_order = value == 0;
+        else if(!strcmp(argv[i], "--quiet")) quiet = value != 0;
+        else {
+            fprintf( stderr, "unknown option %s\n", argv[i] );
+            return 1;
+        }
+    }
+
+    try {
+        MemoryTables initial;
+        {
+            const MappedSnapshot snapshot( argv[1] );
+            initial = MemoryTables( { snapshot.reserves.begin(), snapshot.reserves.end() },
+                                    { snapshot.collaterals.begin(), snapshot.collaterals.end() },
+                                    { snapshot.loans.begin(), snapshot.loans.end() },
+                                    { snapshot.liqdtorders.begin(), snapshot.liqdtorders.end() },
+                                    { snapshot.cachedhealths.begin(), snapshot.cachedhealths.end() } );
+            initial.time = snapshot.now();
+        }
+        std::ifstream in( argv[2], std::ios::binary );
+        check( in.is_open(), std::string( "pizzalend_replay: can't open " ) + argv[2] );
+
+        Replay replay( std::move(initial) );
+        if(!quiet) printf( "%-12s %8s %8s %14s %14s %10s\n", "time", "events", "orders", "opportunities", "profit", "cpu_us" );
+        const auto stats = replay.run( in, policy, [&](const ReplayBlock& block) {
+            if(!quiet) printf( "%-12llu %8u %8u %14u %14.4f %10.1f\n", (unsigned long long) block.time, block.events, block.orders,
+                               block.opportunities, block.profit, block.cpu_ns / 1000.0 );
+        });
+        printf( "blocks=%llu events=%llu orders=%llu opportunities=%llu profit=%.4f cpu_ms=%.3f max_block_cpu_us=%.1f\n",
+                (unsigned long long) stats.blocks, (unsigned long long) stats.events, (unsigned long long) stats.orders,
+                (unsigned long long) stats.opportunities, stats.profit, stats.cpu_ns / 1e6, stats.max_cpu_ns / 1000.0 );
+    } catch(const std::exception& e) {
+        fprintf( stderr, "%s\n", e.what() );
+        return 1;
+    }
+    return 0;
+}
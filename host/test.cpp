@@ -0,0 +1,756 @@
+// Host tests: fixed-point kernel, quotes and liquidation solver against independent reference math,
+// and `ChainTables` (host multi_index), snapshots and replay against `MemoryTables` on synthetic markets
+
+#include <cstdio>
+#include <filesystem>
+#include <sstream>
+
+#include "native.hpp"
+#include "snapshot.hpp"
+#include "replay.hpp"
+#include "generate.hpp"
+
+using namespace pizzalend;
+
+struct test_case {
+    const char*     name;
+    void            (*run)();
+};
+
+static vector<test_case>& get_tests() {
+    static vector<test_case> tests;
+    return tests;
+}
+
+static int failures = 0;
+
+#define TEST( name ) \
+    static void name(); \
+    static const bool name##_registered = (get_tests().push_back({ #name, name }), true); \
+    static void name()
+
+#define CHECK( cond ) do { \
+    if(!(cond)) { ++failures; printf( "%s:%d: CHECK( %s ) failed\n", __FILE__, __LINE__, #cond ); } \
+} while(0)
+
+#define CHECK_THROWS( expr ) do { \
+    bool thrown = false; \
+    try { expr; } catch(const eosio::check_failure&) { thrown = true; } \
+    if(!thrown) { ++failures; printf( "%s:%d: %s didn't throw\n", __FILE__, __LINE__, #expr ); } \
+} while(0)
+
+// pzprice == mantissa * 2^-shift, decoded with frexp instead of from the IEEE-754 bits as `PzPrice` does
+struct reference_price {
+    uint128_t   mantissa;
+    int         shift;
+
+    explicit reference_price( const double pzprice ) {
+        int exp;
+        mantissa = static_cast<uint64_t>( std::ldexp( std::frexp( pzprice, &exp ), 53 ) );
+        shift = 53 - exp;
+    }
+
+    int64_t mul( const int64_t amount ) const { return ( amount * mantissa ) >> shift; }
+    int64_t mul_ceil( const int64_t amount ) const { return ( amount * mantissa + (static_cast<uint128_t>(1) << shift) - 1 ) >> shift; }
+    int64_t div( const int64_t amount ) const { return ( static_cast<uint128_t>(amount) << shift ) / mantissa; }
+    int64_t div_ceil( const int64_t amount ) const { return ( ( static_cast<uint128_t>(amount) << shift ) + mantissa - 1 ) / mantissa; }
+};
+
+static pztoken_row get_row( const double pzprice, const int64_t available = std::numeric_limits<int64_t>::max() ) {
+    pztoken_row row {};
+    row.pztoken = "pzusdt"_n;
+    row.pzsymbol = { symbol{"PZUSDT", 4}, token_code };
+    row.anchor = { symbol{"USDT", 4}, "tethertether"_n };
+    row.available_deposit = { available, symbol{"USDT", 4} };
+    row.price = { 1'0000, symbol{"USD", 4} };
+    row.pzprice = pzprice;
+    row.config.liqdt_rate = { 8000, symbol{"X", 4} };
+    return row;
+}
+
+TEST( fixed_point_value ) {
+    CHECK( get_value( asset{ 12345, symbol{"EOS", 4} }, asset{ 35000, symbol{"USD", 4} } ) == 432075000 );
+    CHECK( get_value( asset{ 5, symbol{"A", 0} }, asset{ 3, symbol{"USD", 2} } ) == 15000000 );
+    CHECK( get_value( asset{ 1'00000000, symbol{"OUSD", 8} }, asset{ 1'0000, symbol{"USD", 4} } ) == 1'00000000 );
+    CHECK( apply_rate( 1000'00000000, asset{ 8000, symbol{"X", 4} } ) == 800'00000000 );
+    CHECK( to_double( 1'50000000 ) == 1.5 );
+    CHECK_THROWS( mul_div( std::numeric_limits<int64_t>::max(), 2, 1 ) );
+
+    // get_amount is floor(value * 10^k / price) for value precision 10^-8
+    std::mt19937_64 rng( 5 );
+    for(int i = 0; i < 10000; ++i) {
+        const uint8_t precision = std::uniform_int_distribution<int>( 0, 9 )( rng );
+        const symbol sym { "TK", precision };
+        const asset price { std::uniform_int_distribution<int64_t>( 1, 1'000'000'0000 )( rng ), symbol{"USD", 4} };
+        const int64_t value = std::uniform_int_distribution<int64_t>( 0, 1'000'000'00000000 )( rng );
+        const int k = precision + 4 - VALUE_PRECISION;
+        const uint128_t expected = k >= 0 ? static_cast<uint128_t>(value) * pow10(k) / price.amount
+                                          : static_cast<uint128_t>(value) / (static_cast<uint128_t>(price.amount) * pow10(-k));
+        CHECK( get_amount( value, price, sym ) == static_cast<int64_t>(expected) );
+    }
+}
+
+TEST( fixed_point_pzprice ) {
+    // 0.1 is slightly above 1/10 as a double
+    const auto tenth = PzPrice::from_double( 0.1 );
+    CHECK( tenth.mul( 10 ) == 1 );
+    CHECK( tenth.mul_ceil( 10 ) == 2 );
+    CHECK( tenth.div( 1 ) == 9 );
+    CHECK( tenth.div_ceil( 1 ) == 10 );
+
+    const auto half = PzPrice::from_double( 1.5 );
+    CHECK( half.mul( 3 ) == 4 );
+    CHECK( half.mul_ceil( 3 ) == 5 );
+    CHECK( half.div( 3 ) == 2 );
+    CHECK( half.div_ceil( 3 ) == 2 );
+
+    // exact above 2^53, where a double product rounds
+    const int64_t large = (1LL << 53) + 1;
+    CHECK( PzPrice::from_double( 1.0 ).mul( large ) == large );
+    CHECK( PzPrice::from_double( 0.5 ).mul( large * 2 ) == large );
+    CHECK( PzPrice::from_double( 4.0 ).div( large * 4 ) == large );
+    CHECK_THROWS( PzPrice::from_double( -1.0 ) );
+
+    std::mt19937_64 rng( 7 );
+    for(int i = 0; i < 100000; ++i) {
+        const double pzprice = std::uniform_real_distribution<double>( 0.5, 4.0 )( rng );
+        const int64_t amount = std::uniform_int_distribution<int64_t>( 0, 1LL << (i % 60 + 1) )( rng );
+        const auto price = PzPrice::from_double( pzprice );
+        const reference_price expected( pzprice );
+        CHECK( price.div( amount ) == expected.div( amount ) );
+        CHECK( price.div_ceil( amount ) == expected.div_ceil( amount ) );
+        if(amount < (1LL << 60)) {
+            CHECK( price.mul( amount ) == expected.mul( amount ) );
+            CHECK( price.mul_ceil( amount ) == expected.mul_ceil( amount ) );
+        }
+    }
+}
+
+TEST( fixed_point_wrap_unwrap ) {
+    const auto row = get_row( 1.1574, 5000'0000 );
+    const reference_price expected( row.pzprice );
+    CHECK( wrap( asset{ 100'0000, symbol{"USDT", 4} }, row ).quantity == asset( expected.div( 100'0000 ), symbol{"PZUSDT", 4} ) );
+    CHECK( unwrap( asset{ 100'0000, symbol{"PZUSDT", 4} }, row ).quantity == asset( expected.mul( 100'0000 ), symbol{"USDT", 4} ) );
+
+    // unwrap beyond the available deposit returns 0 unless ignored
+    CHECK( unwrap( asset{ 5000'0000, symbol{"PZUSDT", 4} }, row ).quantity.amount == 0 );
+    CHECK( unwrap( asset{ 5000'0000, symbol{"PZUSDT", 4} }, row, true ).quantity.amount == expected.mul( 5000'0000 ) );
+
+    const auto [ value, liq_value ] = get_oraclized_value( extended_asset{ asset{ 1000'0000, symbol{"USDT", 4} }, "tethertether"_n }, row );
+    CHECK( value == 1000.0 );
+    CHECK( liq_value == 800.0 );
+    CHECK_THROWS( get_oraclized_value( extended_asset{ asset{ 1000'0000, symbol{"USDT", 4} }, "fake.token"_n }, row ) );
+}
+
+TEST( accrued_interest ) {
+    const auto reserve = get_row( 1.0 );
+    const symbol usdt { "USDT", 4 }, rate { "X", 4 };
+
+    // 1000 USDT at 10% for half a year, timestamps in seconds
+    loan_row loan { 0, "alice"_n, "pzusdt"_n, { 1000'0000, usdt }, { 1000'0000'0000, usdt }, 2, { 1000, rate }, 0, 1'650'000'000, 1'650'000'000 };
+    CHECK( get_accrued_interest( loan, reserve, loan.last_calculated_at + SECONDS_PER_YEAR / 2 ) == 50'0000'0000 );
+    CHECK( get_accrued_interest( loan, reserve, loan.last_calculated_at ) == 0 );
+
+    // owed tokens round up only when the x10000 quantity isn't a whole amount
+    CHECK( get_loan( loan, reserve, loan.last_calculated_at ).tokens.quantity.amount == 1000'0000 );
+    loan.quantity.amount += 1;
+    CHECK( get_loan( loan, reserve, loan.last_calculated_at ).tokens.quantity.amount == 1000'0001 );
+    loan.quantity.amount -= 1;
+
+    // no interest at or before the last calculation
+    CHECK( get_accrued_interest( loan, reserve, loan.last_calculated_at - 1 ) == 0 );
+    CHECK( get_accrued_interest( loan, reserve, 0 ) == 0 );
+    CHECK( get_loan( loan, reserve, loan.last_calculated_at - SECONDS_PER_YEAR ).tokens.quantity.amount == 1000'0000 );
+
+    // variable rate (type 1) accrues at the reserve's floating rate, not the loan's fixed rate
+    auto floating = reserve;
+    floating.floating_rate = { 400, rate };
+    loan.type = 1;
+    CHECK( get_accrued_interest( loan, floating, loan.last_calculated_at + SECONDS_PER_YEAR / 2 ) == 20'0000'0000 );
+    floating.floating_rate.amount = 0;
+    CHECK( get_accrued_interest( loan, floating, loan.last_calculated_at + SECONDS_PER_YEAR ) == 0 );
+
+    // never calculated: accrues from updated_at
+    floating.floating_rate.amount = 400;
+    loan.last_calculated_at = 0;
+    loan.updated_at = 1'650'000'000 + SECONDS_PER_YEAR / 2;
+    CHECK( get_accrued_interest( loan, floating, 1'650'000'000 + SECONDS_PER_YEAR ) == 20'0000'0000 );
+    CHECK( get_accrued_interest( loan, floating, loan.updated_at ) == 0 );
+    CHECK( get_loan( loan, floating, 1'650'000'000 + SECONDS_PER_YEAR ).tokens.quantity.amount == 1020'0000 );
+}
+
+TEST( liq_scan ) {
+    auto tables = synthetic::generate_market({ .accounts = 300, .liqdtorders = 40 });
+    for(size_t i = 0; i < tables.liqdtorders.size(); i += 5) tables.liqdtorders[i].collateral.quantity.symbol = symbol{ "PZUSDI", 4 };
+    const ReserveSnapshot reserves( tables );
+    vector<uint64_t> expected;
+    for(const auto& row: get_liq_accounts( 0, reserves, tables )) expected.push_back( row.id );
+    CHECK( !expected.empty() && expected.size() < tables.liqdtorders.size() );
+
+    // pages of a few rows cover the same orders as one full scan
+    for(const uint32_t max_rows: { 1, 3, 7 }) {
+        vector<uint64_t> found;
+        uint64_t start_id = 0;
+        size_t pages = 0;
+        for(bool done = false; !done; ++pages) {
+            const auto page = scan_liq_accounts( 0, start_id, max_rows, reserves, tables );
+            CHECK( page.orders.size() <= max_rows );
+            for(size_t i = 0; i < page.orders.size(); ++i) {
+                CHECK( i == 0 || page.orders[i - 1].value >= page.orders[i].value );
+                CHECK( !contains_code( page.orders[i].order.collateral.quantity.symbol.code(), LIQ_EXCLUDED_CODE ) );
+                found.push_back( page.orders[i].order.id );
+            }
+            CHECK( page.done || page.next_id > start_id );
+            start_id = page.next_id;
+            done = page.done;
+        }
+        std::sort( found.begin(), found.end() );
+        CHECK( found == expected );
+        CHECK( pages == (tables.liqdtorders.size() + max_rows - 1) / max_rows );
+    }
+    CHECK_THROWS( scan_liq_accounts( 0, 0, 0, reserves, tables ) );
+}
+
+TEST( amount_in ) {
+    std::mt19937_64 rng( 11 );
+    const symbol anchor { "USDT", 4 }, pz { "PZUSDT", 4 };
+    for(int i = 0; i < 20000; ++i) {
+        const auto row = get_row( std::uniform_real_distribution<double>( 0.8, 1.6 )( rng ) );
+        const int64_t out = std::uniform_int_distribution<int64_t>( 1, 1'000'000'0000 )( rng );
+
+        // wrap: smallest deposit receiving at least {out} pz-tokens
+        const auto wrap_in = get_amount_in( asset{ out, pz }, anchor, row );
+        CHECK( wrap_in.in.symbol == anchor );
+        CHECK( wrap( wrap_in.in, row ).quantity.amount >= out );
+        CHECK( wrap( asset{ wrap_in.in.amount - 1, anchor }, row ).quantity.amount < out );
+
+        // unwrap: smallest redeem receiving at least {out} tokens
+        const auto unwrap_in = get_amount_in( asset{ out, anchor }, pz, row );
+        CHECK( unwrap_in.max_out == row.available_deposit );
+        CHECK( unwrap( unwrap_in.in, row ).quantity.amount >= out );
+        CHECK( unwrap( asset{ unwrap_in.in.amount - 1, pz }, row ).quantity.amount < out );
+    }
+
+    // liquidity limit is reported instead of silently quoting 0
+    const auto row = get_row( 1.2, 100'0000 );
+    const auto res = get_amount_in( asset{ 200'0000, anchor }, pz, row );
+    CHECK( res.in.amount == 0 );
+    CHECK( res.max_out == asset( 100'0000, anchor ) );
+    CHECK_THROWS( get_amount_in( asset{ 10000, symbol{"EOS", 4} }, pz, row ) );
+
+    // rounding up the input redeems 66174 > 66173 available, so `unwrap` would return 0
+    const auto limit = get_row( 1.24068, 66173 );
+    CHECK( unwrap( asset{ 53337, pz }, limit ).quantity.amount == 0 );
+    CHECK( get_amount_in( asset{ 66173, anchor }, pz, limit ).in.amount == 0 );
+
+    // at the liquidity limit, a non-zero quote always unwraps to at least {out}
+    for(int i = 0; i < 20000; ++i) {
+        const int64_t available = std::uniform_int_distribution<int64_t>( 1, 1'000'000'0000 )( rng );
+        const auto row = get_row( std::uniform_real_distribution<double>( 0.8, 1.6 )( rng ), available );
+        const auto res = get_amount_in( asset{ available, anchor }, pz, row );
+        if(res.in.amount) CHECK( unwrap( res.in, row ).quantity.amount >= available );
+        else CHECK( unwrap( asset{ PzPrice::from_double( row.pzprice ).div_ceil( available ), pz }, row ).quantity.amount == 0 );
+    }
+}
+
+TEST( amounts_out ) {
+    auto tables = synthetic::generate_market({ .accounts = 10 });
+    tables.reserves.front().available_deposit.amount = 5000'0000;
+    const ReserveSnapshot reserves( tables );
+
+    // both directions of every reserve, each pair repeated, unwraps on both sides of the available deposit
+    std::mt19937_64 rng( 17 );
+    vector<pair<asset, symbol>> requests;
+    for(int repeat = 0; repeat < 3; ++repeat) {
+        for(const auto& row: reserves.rows) {
+            const symbol anchor = row.anchor.get_symbol(), pz = row.pzsymbol.get_symbol();
+            const int64_t max_pz = PzPrice::from_double( row.pzprice ).div( row.available_deposit.amount );
+            for(int i = 0; i < 4; ++i) {
+                const int64_t amount = std::uniform_int_distribution<int64_t>( 1, max_pz * 2 )( rng );
+                requests.push_back({ asset{ amount, anchor }, pz });
+                requests.push_back({ asset{ amount, pz }, anchor });
+            }
+            requests.push_back({ asset{ max_pz, pz }, anchor });
+            requests.push_back({ asset{ max_pz + 1, pz }, anchor });
+        }
+    }
+    const auto outs = get_amounts_out( requests, reserves );
+    CHECK( outs.size() == requests.size() );
+    size_t cut = 0;
+    for(size_t i = 0; i < requests.size(); ++i) {
+        CHECK( outs[i] == get_amount_out( requests[i].first, requests[i].second, reserves ) );
+        cut += outs[i].amount == 0;
+    }
+    CHECK( cut > 0 );
+
+    const auto& row = reserves.rows.front();
+    const int64_t max_pz = PzPrice::from_double( row.pzprice ).div( row.available_deposit.amount );
+    const vector<pair<asset, symbol>> limit = { { asset{ max_pz, row.pzsymbol.get_symbol() }, row.anchor.get_symbol() },
+                                                { asset{ max_pz * 2, row.pzsymbol.get_symbol() }, row.anchor.get_symbol() } };
+    const auto limit_outs = get_amounts_out( limit, reserves );
+    CHECK( limit_outs[0].amount > 0 && limit_outs[0].amount <= row.available_deposit.amount );
+    CHECK( limit_outs[1].amount == 0 );
+
+    // one reserve's anchor with another reserve's pz-token
+    const auto& other = reserves.rows.back();
+    const vector<pair<asset, symbol>> mismatched = { requests.front(), { asset{ 10000, row.anchor.get_symbol() }, other.pzsymbol.get_symbol() } };
+    CHECK_THROWS( get_amounts_out( mismatched, reserves ) );
+
+    synthetic::load_chain( tables );
+    CHECK( get_amounts_out( requests ) == outs );
+}
+
+TEST( amount_in_chain ) {
+    const auto tables = synthetic::generate_market({ .accounts = 10 });
+    synthetic::load_chain( tables );
+    const ReserveSnapshot reserves;
+    for(const auto& row: reserves.rows) {
+        const asset out { 123'4567, row.pzsymbol.get_symbol() };
+        const auto res = get_amount_in( out, row.anchor.get_symbol() );
+        CHECK( res.in == get_amount_in( out, row.anchor.get_symbol(), reserves ).in );
+        CHECK( get_amount_out( res.in, out.symbol ).amount >= out.amount );
+    }
+}
+
+TEST( registry ) {
+    const auto tables = synthetic::generate_market({ .accounts = 10 });
+    synthetic::load_chain( tables );
+    const ReserveSnapshot reserves;
+    for(const auto& key: PZ_KEYS) {
+        const auto row = reserves.by_pzname( key.pzname );
+        CHECK( row != nullptr );
+        if(!row) continue;
+        CHECK( row->pzsymbol.get_symbol().code() == key.pzcode );
+        CHECK( row->anchor == key.anchor );
+        CHECK( is_pztoken( row->pzsymbol.get_symbol() ) );
+
+        bool is_pz = true;
+        CHECK( get_pzkey( key.anchor.get_symbol().code(), &is_pz ) == &key && !is_pz );
+        CHECK( get_pzkey( key.pzcode, &is_pz ) == &key && is_pz );
+        const asset in { 1000'0000, key.anchor.get_symbol() };
+        CHECK( wrap( in ) == wrap( in, reserves ) );
+        CHECK( unwrap( wrap( in ).quantity ) == unwrap( wrap( in ).quantity, reserves ) );
+    }
+    CHECK( get_pzkey( symbol_code{"TKA"} ) == nullptr );
+}
+
+// best profit of liquidating {loans} for {collaterals} by trying every amount
+static int64_t brute_force_profit( std::span<const OraclizedAsset> loans, std::span<const OraclizedAsset> collaterals, const ReserveSnapshot& reserves, const bool respect_order ) {
+    double loans_value = 0;
+    uint8_t loan_order = 255, coll_order = 255;
+    for(const auto& loan: loans) {
+        loans_value += loan.value;
+        loan_order = std::min( loan_order, get_reserve( loan.tokens.get_extended_symbol(), reserves ).config.borrow_liqdt_order );
+    }
+    for(const auto& coll: collaterals)
+        coll_order = std::min( coll_order, get_reserve( coll.tokens.get_extended_symbol(), reserves ).config.collateral_liqdt_order );
+
+    int64_t best = 0;
+    for(const auto& loan: loans) {
+        const auto& loan_res = get_reserve( loan.tokens.get_extended_symbol(), reserves );
+        if(respect_order && loan_res.config.borrow_liqdt_order != loan_order) continue;
+        for(const auto& coll: collaterals) {
+            const auto& coll_res = get_reserve( coll.tokens.get_extended_symbol(), reserves );
+            if(respect_order && coll_res.config.collateral_liqdt_order != coll_order) continue;
+            for(int64_t amount = 1; amount <= loan.tokens.quantity.amount; ++amount) {
+                const extended_asset in { amount, loan.tokens.get_extended_symbol() };
+                const auto out = get_liquidation_out( in, coll.tokens.get_extended_symbol(), loans, collaterals, reserves );
+                best = std::max( best, get_value( out.quantity, coll_res.price ) - get_value( in.quantity, loan_res.price ) );
+            }
+        }
+    }
+    return best;
+}
+
+TEST( best_liquidation ) {
+    std::mt19937_64 rng( 13 );
+    for(int trial = 0; trial < 60; ++trial) {
+        std::mt19937_64 reserve_rng( trial );
+        const ReserveSnapshot reserves( synthetic::generate_reserves({ .reserves = 6 }, reserve_rng) );
+
+        // small positions in units of the smallest token amount so every amount can be tried
+        vector<OraclizedAsset> loans, collaterals;
+        for(const auto& row: reserves.rows) {
+            const auto add = [&](vector<OraclizedAsset>& positions) {
+                const extended_asset tokens { std::uniform_int_distribution<int64_t>( 1, 3000 )( rng ), row.anchor };
+                const auto [ value, ratioed ] = get_oraclized_value( tokens, row );
+                positions.push_back({ tokens, value, ratioed });
+            };
+            if(std::uniform_int_distribution<int>( 0, 2 )( rng ) == 0) add( loans );
+            if(std::uniform_int_distribution<int>( 0, 2 )( rng ) == 0) add( collaterals );
+        }
+
+        for(const bool respect_order: { true, false }) {
+            const auto plan = get_best_liquidation( loans, collaterals, reserves, respect_order );
+            const int64_t expected = brute_force_profit( loans, collaterals, reserves, respect_order );
+            if(expected == 0) {
+                CHECK( plan.in.quantity.amount == 0 );
+                continue;
+            }
+
+            // within the value of one smallest debt unit of the optimum
+            const auto& loan_res = get_reserve( plan.in.get_extended_symbol(), reserves );
+            const auto& coll_res = get_reserve( plan.out.get_extended_symbol(), reserves );
+            const int64_t profit = get_value( plan.out.quantity, coll_res.price ) - get_value( plan.in.quantity, loan_res.price );
+            CHECK( profit <= expected );
+            CHECK( profit >= expected - get_value( asset{ 1, plan.in.quantity.symbol }, loan_res.price ) );
+            CHECK( plan.out == get_liquidation_out( plan.in, plan.out.get_extended_symbol(), loans, collaterals, reserves ) );
+        }
+    }
+
+    const ReserveSnapshot reserves( vector<pztoken_row>{ get_row( 1.0 ) } );
+    CHECK( get_best_liquidation( {}, {}, reserves ).in.quantity.amount == 0 );
+}
+
+TEST( pztoken_view_offsets ) {
+    const auto tables = synthetic::generate_market({ .accounts = 10 });
+    synthetic::load_chain( tables );
+    pztoken_view::for_each([&](const pztoken_view& view) {
+        const auto row = view.row();
+        CHECK( view.pzname() == row.pztoken );
+        CHECK( view.pzsymbol() == row.pzsymbol );
+        CHECK( view.anchor() == row.anchor );
+        CHECK( view.available_deposit() == row.available_deposit );
+        CHECK( view.price() == row.price );
+        CHECK( view.pzprice() == row.pzprice );
+        CHECK( view.pzprice_rate() == row.pzprice_rate );
+        CHECK( view.updated_at() == row.updated_at );
+        CHECK( view.liqdt_rate() == row.config.liqdt_rate );
+        CHECK( view.liqdt_bonus() == row.config.liqdt_bonus );
+        CHECK( view.max_ltv() == row.config.max_ltv );
+        CHECK( eosio::pack( row ).size() == pztoken_view::SIZE );
+        return true;
+    });
+}
+
+TEST( positions ) {
+    auto tables = synthetic::generate_market({ .reserves = 24, .accounts = 1, .collaterals = 20, .borrowers = 0 });
+    const ReserveSnapshot reserves( tables );
+    const name account = tables.collaterals.front().account;
+
+    // more collaterals than `MAX_POSITIONS` spill to the heap in order
+    const auto collaterals = get_collaterals( account, reserves, tables );
+    CHECK( collaterals.size() == 20 && collaterals.size() > MAX_POSITIONS );
+    size_t i = 0;
+    for_each_collateral( account, reserves, [&](const OraclizedAsset& coll, const pztoken_row&) {
+        CHECK( collaterals[i++].tokens == coll.tokens );
+    }, tables );
+    const vector<OraclizedAsset> copy = collaterals;
+    CHECK( copy.size() == collaterals.size() && copy.back().tokens == collaterals.back().tokens );
+    CHECK( get_loans( account, reserves, tables ).empty() );
+}
+
+TEST( parallel_for_exceptions ) {
+    // the first exception in a worker is rethrown on the calling thread once all workers joined
+    for(const unsigned threads: { 1u, 4u }) {
+        std::atomic<size_t> calls = 0;
+        CHECK_THROWS( parallel_for( 10000, threads, [&](const size_t i) {
+            ++calls;
+            check( i != 5000, "pizzalend: test: failure in worker" );
+        }, 16 ) );
+        CHECK( calls > 0 && calls <= 10000 );
+    }
+
+    vector<int> seen( 10000 );
+    parallel_for( seen.size(), 4, [&](const size_t i){ ++seen[i]; }, 16 );
+    CHECK( std::all_of( seen.begin(), seen.end(), [](const int n){ return n == 1; } ) );
+}
+
+TEST( position_simulator ) {
+    const auto tables = synthetic::generate_market({ .accounts = 200 });
+    const ReserveSnapshot reserves( tables ), other( tables );
+    for(const auto& cached: tables.cachedhealths) {
+        // rows of {position} belong to another snapshot of the same tables
+        const AccountPosition position( cached.account, other, tables );
+        const PositionSimulator initial( position, reserves );
+        CHECK( std::abs( initial.get_loan_value() - position.loan_value ) < 1e-6 );
+
+        // liquidation follows `get_liquidation_out`
+        const auto& loan = position.loans[0].tokens;
+        for(const auto& coll: position.collaterals) {
+            PositionSimulator sim = initial;
+            const extended_asset in { loan.quantity.amount / 3, loan.get_extended_symbol() };
+            const auto out = sim.liquidate( in, coll.tokens.get_extended_symbol() );
+            CHECK( out == get_liquidation_out( in, coll.tokens.get_extended_symbol(), position.loans, position.collaterals, reserves ) );
+            sim.withdraw( { coll.tokens.quantity.amount - out.quantity.amount, coll.tokens.get_extended_symbol() } );
+            CHECK( sim.get_max_withdraw( coll.tokens.get_extended_symbol() ).amount == 0 );
+            CHECK( sim.liquidate( loan, coll.tokens.get_extended_symbol() ).quantity.amount == 0 );
+        }
+
+        // repaying more than owed repays the whole loan
+        PositionSimulator repaid = initial;
+        repaid.repay( { loan.quantity.amount * 2, loan.get_extended_symbol() } );
+        CHECK( repaid.get_loan_value() == 0 && repaid.health_factor() == 0 );
+        CHECK( repaid.get_collateral_value() == initial.get_collateral_value() );
+
+        // extra collateral worth 4x the loans, so there is room to borrow and withdraw
+        PositionSimulator sim = initial;
+        const auto& deposit = position.collaterals[0].tokens;
+        const auto& price = get_reserve( deposit.get_extended_symbol(), reserves ).price;
+        sim.deposit( { get_amount( to_value( 4 * initial.get_loan_value() ), price, deposit.quantity.symbol ), deposit.get_extended_symbol() } );
+        CHECK( sim.get_borrow_limit() > sim.get_loan_value() );
+        for(const auto& row: reserves.rows) {
+            const asset max_borrow = sim.get_max_borrow( row.anchor );
+            PositionSimulator borrowed = sim;
+            borrowed.borrow( { max_borrow.amount, row.anchor } );
+            CHECK( borrowed.get_borrow_limit() >= borrowed.get_loan_value() );
+            if(max_borrow == row.available_deposit) continue;
+            borrowed.borrow( { 1, row.anchor } );
+            CHECK( borrowed.get_borrow_limit() < borrowed.get_loan_value() );
+        }
+        for(const auto& coll: position.collaterals) {
+            const asset max_withdraw = sim.get_max_withdraw( coll.tokens.get_extended_symbol() );
+            PositionSimulator withdrawn = sim;
+            withdrawn.withdraw( { max_withdraw.amount, coll.tokens.get_extended_symbol() } );
+            CHECK( withdrawn.get_borrow_limit() >= withdrawn.get_loan_value() );
+        }
+    }
+    CHECK_THROWS( PositionSimulator( AccountPosition( tables.cachedhealths.front().account, reserves, tables ),
+                                     ReserveSnapshot( vector<pztoken_row>{ get_row( 1.0 ) } ) ) );
+}
+
+TEST( chain_matches_memory_tables ) {
+    const auto tables = synthetic::generate_market({ .accounts = 300, .liqdtorders = 30 });
+    synthetic::load_chain( tables );
+    const ReserveSnapshot chain_reserves;
+    const ReserveSnapshot reserves( tables );
+    CHECK( chain_reserves.rows.size() == reserves.rows.size() );
+
+    for(const auto& row: tables.cachedhealths) {
+        CHECK( get_health_factor( row.account ) == get_health_factor( row.account, reserves, tables ) );
+        CHECK( get_loans( row.account ).size() == get_loans( row.account, reserves, tables ).size() );
+    }
+    for(const auto& row: reserves.rows) {
+        const asset in { 1000'0000, row.anchor.get_symbol() };
+        const asset out = get_amount_out( in, row.pzsymbol.get_symbol() );
+        CHECK( out == get_amount_out( in, row.pzsymbol.get_symbol(), reserves ) );
+        CHECK( get_amount_out( out, in.symbol ) == get_amount_out( out, in.symbol, reserves ) );
+    }
+    CHECK( get_liq_accounts( 10 ).size() == get_liq_accounts( 10, reserves, tables ).size() );
+
+    const auto market = get_market_health( tables, reserves, 1.0, 4 );
+    for(const auto& health: market.accounts)
+        CHECK( health.health_factor == get_health_factor( health.account, reserves, tables ) );
+}
+
+TEST( cached_health_factor ) {
+    auto tables = synthetic::generate_market({ .accounts = 50 });
+    const auto& cached = tables.cachedhealths.front();
+    vector<name> pznames;
+    tables.for_each_collateral( cached.account, [&](const collateral_row& row){ pznames.push_back( row.pzname ); });
+    tables.for_each_loan( cached.account, [&](const loan_row& row){ pznames.push_back( row.pzname ); });
+
+    // a reserve the account doesn't use is updated after the cached row
+    for(auto& row: tables.reserves) {
+        const bool used = std::find( pznames.begin(), pznames.end(), row.pztoken ) != pznames.end();
+        row.updated_at = used ? cached.updated_at : cached.updated_at + 1;
+    }
+    const ReserveSnapshot reserves( tables );
+    CHECK( reserves.get_updated_at( pznames ) == cached.updated_at );
+    CHECK( reserves.get_updated_at( vector<name>{ "unknown"_n } ) == std::numeric_limits<uint64_t>::max() );
+
+    const auto all = get_health_factor( cached.account, 600, reserves, {}, tables );
+    CHECK( !all.cached );
+    CHECK( all.factor == get_health_factor( cached.account, reserves, tables ) );
+    const auto own = get_health_factor( cached.account, 600, reserves, pznames, tables );
+    CHECK( own.cached );
+    CHECK( own.factor == cached.factor );
+    CHECK( !get_health_factor( cached.account, 0, reserves, pznames, tables ).cached || tables.time == cached.updated_at );
+
+    // no block time, or a clock behind the cached row, recomputes
+    for(const uint64_t time: { uint64_t(0), cached.updated_at - 1 }) {
+        tables.time = time;
+        CHECK( !get_health_factor( cached.account, 0, reserves, pznames, tables ).cached );
+        CHECK( !get_health_factor( cached.account, 600, reserves, pznames, tables ).cached );
+    }
+    tables.time = cached.updated_at;
+    CHECK( get_health_factor( cached.account, 0, reserves, pznames, tables ).cached );
+}
+
+TEST( health_index_time ) {
+    auto tables = synthetic::generate_market({ .accounts = 2000 });
+    for(const uint64_t reprice_interval: { 0ULL, 3600ULL, 365ULL * 24 * 3600 }) {
+        tables.time = 1'650'000'000;
+        HealthIndex index( tables, reprice_interval );
+        for(const uint64_t days: { 1, 30, 90 }) {
+            tables.time = 1'650'000'000 + days * 24 * 3600;
+            index.set_time( tables.time );
+            const ReserveSnapshot reserves( tables );
+            const auto market = get_market_health( tables, reserves, 1.0, 1 );
+            const auto below = index.below( 1.0 );
+            CHECK( below.size() == market.below.size() );
+            for(size_t i = 0; i < below.size(); ++i) CHECK( below[i].health_factor < 1.0 );
+
+            const auto borrower = std::find_if( market.accounts.begin(), market.accounts.end(), [](const AccountHealth& h){ return h.loan_value > 0; });
+            CHECK( !below.empty() && borrower != market.accounts.end() );
+            CHECK( index.get( borrower->account )->loan_value == borrower->loan_value );
+        }
+    }
+}
+
+TEST( stress_test ) {
+    const auto tables = synthetic::generate_market({ .accounts = 2000 });
+    const ReserveSnapshot reserves( tables );
+    const StressTest stress( tables, reserves );
+
+    // shocks on the same reserve compound, matching `get_market_health` on repriced tables
+    const vector<StressScenario> scenarios = {
+        { { "pzeos"_n, 0.5 }, { "pzeos"_n, 0.5 } },
+        { { "pzeos"_n, 0.8 }, { "pzusdt"_n, 1.5 }, { "pzeos"_n, 0.9 } },
+        { { "pzusdt"_n, 1.5 }, { "pzusn"_n, 2.0 } }
+    };
+    const vector<vector<PriceShock>> repriced = {
+        { { "pzeos"_n, 0.25 } },
+        { { "pzeos"_n, 0.72 }, { "pzusdt"_n, 1.5 } },
+        { { "pzusdt"_n, 1.5 }, { "pzusn"_n, 2.0 } }
+    };
+    const auto results = stress.run( scenarios );
+    for(size_t i = 0; i < scenarios.size(); ++i) {
+        CHECK( results[i].accounts == stress.run( repriced[i] ).accounts );
+
+        auto shocked = tables;
+        for(const auto& shock: repriced[i]) {
+            for(auto& row: shocked.reserves)
+                if(row.pztoken == shock.pzname) row.price.amount = std::llround( row.price.amount * shock.multiplier );
+        }
+        const auto market = get_market_health( shocked, ReserveSnapshot( shocked ), 1.0 );
+        double loan_value = 0;
+        for(const auto& health: market.accounts)
+            if(health.loan_value > 0 && health.health_factor < 1.0) loan_value += health.loan_value;
+        CHECK( results[i].accounts == market.below.size() && results[i].accounts > 0 );
+        CHECK( std::abs( results[i].loan_value - loan_value ) < 1e-6 * loan_value );
+    }
+}
+
+TEST( snapshot ) {
+    const auto tables = synthetic::generate_market({ .accounts = 300, .collaterals = 3, .loans = 2, .liqdtorders = 30 });
+    const std::string path = (std::filesystem::temp_directory_path() / "pizzalend_test.snap").string();
+    write_snapshot( path, tables );
+    {
+        const MappedSnapshot snapshot( path );
+        CHECK( snapshot.now() == tables.time );
+        CHECK( snapshot.reserves.size() == tables.reserves.size() && snapshot.liqdtorders.size() == tables.liqdtorders.size() );
+        const ReserveSnapshot reserves( tables );
+        for(const auto& row: tables.cachedhealths) {
+            CHECK( get_health_factor( row.account, reserves, snapshot ) == get_health_factor( row.account, reserves, tables ) );
+            for(const auto& reserve: tables.reserves) {
+                vector<uint64_t> expected, found;
+                tables.for_each_collateral( row.account, [&](const collateral_row& r){ if(r.pzname == reserve.pztoken) expected.push_back( r.id ); });
+                tables.for_each_loan( row.account, [&](const loan_row& r){ if(r.pzname == reserve.pztoken) expected.push_back( r.id ); });
+                snapshot.for_each_collateral( row.account, reserve.pztoken, [&](const collateral_row& r){ found.push_back( r.id ); });
+                snapshot.for_each_loan( row.account, reserve.pztoken, [&](const loan_row& r){ found.push_back( r.id ); });
+                CHECK( found == expected );
+            }
+        }
+    }
+
+    // a snapshot written with another row layout or byte order is rejected
+    for(const size_t field: { offsetof( snapshot_header, layout ), offsetof( snapshot_header, byte_order ) }) {
+        write_snapshot( path, tables );
+        std::fstream file( path, std::ios::binary | std::ios::in | std::ios::out );
+        file.seekp( field );
+        file.put( 0x55 );
+        file.close();
+        CHECK_THROWS( MappedSnapshot{ path } );
+    }
+
+    // account offsets past the rows or out of order, and unsorted accounts, are rejected
+    const auto corrupt = [&](const snapshot_section_id id, const uint64_t item, const auto value) {
+        write_snapshot( path, tables );
+        snapshot_header header {};
+        std::fstream file( path, std::ios::binary | std::ios::in | std::ios::out );
+        file.read( reinterpret_cast<char*>(&header), sizeof(header) );
+        file.seekp( header.section[id].offset + item * sizeof(value) );
+        file.write( reinterpret_cast<const char*>(&value), sizeof(value) );
+        file.close();
+        CHECK_THROWS( MappedSnapshot{ path } );
+    };
+    corrupt( SNAPSHOT_COLLATERAL_OFFSETS, 1, uint32_t(tables.collaterals.size() + 1) );
+    corrupt( SNAPSHOT_LOAN_OFFSETS, 2, uint32_t(0) );
+    corrupt( SNAPSHOT_LOAN_OFFSETS, 0, uint32_t(1) );
+    corrupt( SNAPSHOT_COLLATERAL_ACCOUNTS, 1, tables.collaterals.front().account.value );
+    std::filesystem::remove( path );
+}
+
+TEST( replay ) {
+    const auto initial = synthetic::generate_market({ .accounts = 200, .liqdtorders = 20 });
+    auto loan = initial.loans.front();
+    loan.quantity.amount *= 2;
+    const auto collateral = initial.collaterals.back();
+
+    std::stringstream stream;
+    write_replay_header( stream );
+    write_replay_event( stream, initial.time + 1, loan );
+    write_replay_event( stream, initial.time + 1, collateral, true );
+    write_replay_event( stream, initial.time + 2, initial.reserves.front() );
+    Replay replay( initial );
+    const auto stats = replay.run( stream, { .min_value = 0 } );
+    CHECK( stats.blocks == 2 && stats.events == 3 );
+    CHECK( replay.tables.time == initial.time + 2 );
+    CHECK( replay.tables.loans.front().quantity == loan.quantity );
+    CHECK( replay.tables.collaterals.size() == initial.collaterals.size() - 1 );
+
+    // event sizes are checked against the row struct before reading the row
+    const auto corrupt = [&](const uint8_t table, const uint32_t size) {
+        std::stringstream in;
+        write_replay_header( in );
+        const replay_event event { initial.time, table, 0, 0, size };
+        in.write( reinterpret_cast<const char*>(&event), sizeof(event) );
+        in << std::string( 64, '\0' );
+        Replay replay( initial );
+        replay.run( in, {} );
+    };
+    CHECK_THROWS( corrupt( REPLAY_LOAN, 0xffffffff ) );
+    CHECK_THROWS( corrupt( REPLAY_LOAN, sizeof(loan_row) + 8 ) );
+    CHECK_THROWS( corrupt( 42, 8 ) );
+
+    // a stream without a header, or written with another row layout or byte order, is rejected
+    for(const size_t field: { offsetof( replay_header, magic ), offsetof( replay_header, layout ), offsetof( replay_header, byte_order ) }) {
+        std::string bytes = stream.str();
+        bytes[field] ^= 0x55;
+        std::stringstream in( bytes );
+        Replay replay( initial );
+        CHECK_THROWS( replay.run( in, {} ) );
+    }
+    std::stringstream empty;
+    CHECK_THROWS( replay.run( empty, {} ) );
+}
+
+#ifdef PIZZALEND_INSTRUMENT
+TEST( instrument_counts ) {
+    const auto tables = synthetic::generate_market({ .accounts = 10 });
+    synthetic::load_chain( tables );
+
+    // unregistered reserve: `pztoken` is scanned up to its row, decoding only that row
+    size_t position = 0;
+    while(get_pzkey( tables.reserves[position].pzsymbol.get_symbol().code() )) ++position;
+    instrument::reset();
+    unwrap( asset{ 10000, tables.reserves[position].pzsymbol.get_symbol() } );
+    const auto costs = instrument::get_costs();
+    CHECK( costs.size() == 1 && costs[0].function == "unwrap" && costs[0].calls == 1 );
+    CHECK( costs[0].counters.tables == 0 && costs[0].counters.lookups == 1 );
+    CHECK( costs[0].counters.scanned == position + 1 && costs[0].counters.decoded == 1 );
+
+    // registry reserve: one primary key read
+    instrument::reset();
+    unwrap( asset{ 10000, symbol{"PZUSDT", 4} } );
+    const auto c = instrument::get_costs()[0].counters;
+    CHECK( c.tables == 1 && c.lookups == 1 && c.scanned == 0 && c.decoded == 1 );
+}
+#endif
+
+int main()
+{
+    for(const auto& test: get_tests()) {
+        eosio::host::reset();
+        const int before = failures;
+        try {
+            test.run();
+        } catch(const std::exception& e) {
+            ++failures;
+            printf( "%s: unexpected exception: %s\n", test.name, e.what() );
+        }
+        printf( "%s %s\n", failures == before ? "ok  " : "FAIL", test.name );
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,482 @@
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "pizzalend.hpp"
+
+// Off-chain helpers for bots and monitoring, built on `MemoryTables` (not for WASM contracts)
+namespace pizzalend {
+
+    /**
+     * ## STATIC `parallel_for`
+     *
+     * Run `f(i)` for every `i` in `[0, size)` on {threads} workers (0 = hardware concurrency).
+     * Every worker owns a contiguous range and steals chunks from other workers once its own range is exhausted.
+     * The first exception thrown by `f` stops the remaining chunks and is rethrown once every worker has joined.
+     */
+    template <typename F>
+    static void parallel_for( const size_t size, unsigned threads, F&& f, const size_t chunk = 64 )
+    {
+        if(threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = std::max<size_t>(1, std::min<size_t>(threads, (size + chunk - 1) / chunk));
+        if(threads == 1) {
+            for(size_t i = 0; i < size; ++i) f(i);
+            return;
+        }
+
+        struct range {
+            std::atomic<size_t> next;
+            size_t              end;
+        };
+        vector<range> ranges(threads);
+        for(unsigned t = 0; t < threads; ++t) {
+            ranges[t].next = size * t / threads;
+            ranges[t].end = size * (t + 1) / threads;
+        }
+
+        std::exception_ptr error;
+        std::mutex error_mutex;
+        std::atomic<bool> failed = false;
+        const auto worker = [&](const unsigned self) {
+            try {
+                for(unsigned k = 0; k < threads; ++k) {
+                    auto& r = ranges[(self + k) % threads];
+                    for(size_t begin = r.next.fetch_add(chunk); begin < r.end && !failed; begin = r.next.fetch_add(chunk)) {
+                        const size_t end = std::min(begin + chunk, r.end);
+                        for(size_t i = begin; i < end; ++i) f(i);
+                    }
+                }
+            } catch(...) {
+                const std::lock_guard<std::mutex> lock(error_mutex);
+                if(!error) error = std::current_exception();
+                failed = true;
+            }
+        };
+
+        vector<std::thread> pool;
+        pool.reserve(threads - 1);
+        for(unsigned t = 1; t < threads; ++t) pool.emplace_back(worker, t);
+        worker(0);
+        for(auto& thread: pool) thread.join();
+        if(error) std::rethrow_exception(error);
+    }
+
+    struct AccountHealth {
+        name        account;
+        double      health_factor;          // 0 if account has no loans
+        double      collateral_value;
+        double      ratioed_value;          // collateral value weighted by `liqdt_rate`
+        double      loan_value;
+    };
+
+    struct MarketHealth {
+        vector<AccountHealth>   accounts;   // by account
+        vector<name>            below;      // accounts with loans and health factor below threshold
+    };
+
+    /**
+     * ## STATIC `get_market_health`
+     *
+     * Health factor of every account with collaterals or loans in {tables}
+     *
+     * ### params
+     *
+     * - `{MemoryTables} tables` - state snapshot
+     * - `{ReserveSnapshot} reserves` - reserves snapshot (i.e. `ReserveSnapshot{ tables }`)
+     * - `{double} threshold` - health factor threshold for `below` list
+     * - `{unsigned} threads` - number of worker threads (0 = hardware concurrency)
+     *
+     * ### example
+     *
+     * ```c++
+     * const pizzalend::ReserveSnapshot reserves( tables );
+     * const auto market = pizzalend::get_market_health( tables, reserves, 1.0 );
+     * // => { accounts: [{ "myusername", 1.2345, 500, 375, 303.76 }, ...], below: ["liquidateme"] }
+     * ```
+     */
+    static MarketHealth get_market_health( const MemoryTables& tables, const ReserveSnapshot& reserves, const double threshold = 1, const unsigned threads = 0 )
+    {
+        // group rows by account once: both tables are sorted by account
+        struct account_rows {
+            name        account;
+            uint32_t    coll_begin, coll_end, loan_begin, loan_end;
+        };
+        vector<account_rows> groups;
+        const auto& colls = tables.collaterals;
+        const auto& loans = tables.loans;
+        for(size_t c = 0, l = 0; c < colls.size() || l < loans.size(); ) {
+            const name account = l == loans.size() || (c < colls.size() && colls[c].account < loans[l].account) ? colls[c].account : loans[l].account;
+            account_rows group { account, uint32_t(c), uint32_t(c), uint32_t(l), uint32_t(l) };
+            while(c < colls.size() && colls[c].account == account) ++c;
+            while(l < loans.size() && loans[l].account == account) ++l;
+            group.coll_end = c;
+            group.loan_end = l;
+            groups.push_back(group);
+        }
+
+        // resolve reserve of every row up front so workers only do arithmetic
+        const auto get_reserve = [&](const name pzname) {
+            const auto reserve = reserves.by_pzname(pzname);
+            check(reserve != nullptr, "pizzalend: get_market_health(): unknown reserve");
+            return reserve;
+        };
+        vector<const pztoken_row*> coll_reserves(colls.size()), loan_reserves(loans.size());
+        for(size_t i = 0; i < colls.size(); ++i) coll_reserves[i] = get_reserve(colls[i].pzname);
+        for(size_t i = 0; i < loans.size(); ++i) loan_reserves[i] = get_reserve(loans[i].pzname);
+
+        MarketHealth res;
+        const uint64_t now = tables.now();
+        res.accounts.resize(groups.size());
+        parallel_for(groups.size(), threads, [&](const size_t i) {
+            const auto& group = groups[i];
+            AccountHealth health { group.account, 0, 0, 0, 0 };
+            for(uint32_t c = group.coll_begin; c < group.coll_end; ++c) {
+                const auto coll = get_collateral(colls[c], *coll_reserves[c]);
+                health.collateral_value += coll.value;
+                health.ratioed_value += coll.ratioed;
+            }
+            for(uint32_t l = group.loan_begin; l < group.loan_end; ++l) {
+                health.loan_value += get_loan(loans[l], *loan_reserves[l], now).value;
+            }
+            health.health_factor = health.loan_value == 0 ? 0 : health.ratioed_value / health.loan_value;
+            res.accounts[i] = health;
+        });
+
+        for(const auto& health: res.accounts) {
+            if(health.loan_value > 0 && health.health_factor < threshold) res.below.push_back(health.account);
+        }
+        return res;
+    }
+
+    /**
+     * ## STRUCT `HealthIndex`
+     *
+     * Incremental health factors of every account: row and reserve changes mark only the exposed accounts dirty,
+     * and queries re-price just those before walking accounts in health factor order.
+     *
+     * Time only adds loan interest, so `set_time` doesn't re-price every borrower. Interest accrued since an account
+     * was priced raises its loan value by at most the highest known rate over that time: `below` re-prices only the
+     * accounts within that margin above {threshold}, and `get` re-prices the requested account. Every
+     * {reprice_interval} seconds all borrowers are re-priced, which keeps the margin and the ordering tight.
+     * The margin leaves out the rounding of owed tokens up to one unit per loan.
+     *
+     * ### example
+     *
+     * ```c++
+     * pizzalend::HealthIndex index( tables );
+     *
+     * // every block
+     * for(const auto& row: changed_loans) index.set_loan( row );
+     * index.set_reserve( eos_reserve );
+     * index.set_time( block_time );
+     * const auto below = index.below( 1.0 );
+     * // => [{ "liquidateme", 0.9512, 500, 375, 394.2 }]
+     * ```
+     */
+    struct HealthIndex {
+        explicit HealthIndex( const MemoryTables& tables, const uint64_t reprice_interval = 3600 ):
+            reprice_interval( reprice_interval ), now( tables.now() ), repriced_at( now )
+        {
+            for(const auto& row: tables.reserves) set_rate( row.floating_rate );
+            for(const auto& row: tables.reserves) reserves[row.pztoken.value] = row;
+            for(const auto& row: tables.collaterals) set_collateral( row );
+            for(const auto& row: tables.loans) set_loan( row );
+        }
+
+        // insert or replace a collateral row (by id)
+        void set_collateral( const collateral_row& row ) {
+            set_row( accounts[row.account.value].collaterals, row );
+        }
+
+        // insert or replace a loan row (by id)
+        void set_loan( const loan_row& row ) {
+            set_rate( row.fixed_rate );
+            set_row( accounts[row.account.value].loans, row );
+        }
+
+        void erase_collateral( const name account, const uint64_t id ) {
+            const auto it = accounts.find( account.value );
+            if(it != accounts.end()) erase_row( it->second.collaterals, account, id );
+        }
+
+        void erase_loan( const name account, const uint64_t id ) {
+            const auto it = accounts.find( account.value );
+            if(it != accounts.end()) erase_row( it->second.loans, account, id );
+        }
+
+        // insert or replace a reserve, re-pricing only accounts holding or owing it
+        void set_reserve( const pztoken_row& row ) {
+            set_rate( row.floating_rate );
+            reserves[row.pztoken.value] = row;
+            const auto it = exposed.find( row.pztoken.value );
+            if(it == exposed.end()) return;
+            for(const uint64_t account: it->second) mark_dirty( account );
+        }
+
+        // advance loan interest projection, re-pricing every borrower once per {reprice_interval}
+        void set_time( const uint64_t time ) {
+            if(time == now) return;
+            now = time;
+            if(now < repriced_at + reprice_interval) return;
+            repriced_at = now;
+            for(auto& [ account, state ]: accounts)
+                if(!state.loans.empty()) mark_dirty( account );
+        }
+
+        // accounts with loans and health factor below {threshold}, lowest first
+        vector<AccountHealth> below( const double threshold ) {
+            flush();
+
+            // accounts priced before {now} can have dropped below {threshold} by at most the interest since {repriced_at}
+            if(now > repriced_at) {
+                const double margin = 1 + max_rate * (now - repriced_at) / SECONDS_PER_YEAR;
+                for(auto it = by_health.begin(); it != by_health.end() && it->first < threshold * margin; ++it)
+                    if(accounts.at(it->second).priced_at != now) mark_dirty( it->second );
+                flush();
+            }
+
+            vector<AccountHealth> res;
+            for(auto it = by_health.begin(); it != by_health.end() && it->first < threshold; ++it)
+                res.push_back( accounts.at(it->second).health );
+            return res;
+        }
+
+        std::optional<AccountHealth> get( const name account ) {
+            const auto it = accounts.find( account.value );
+            if(it != accounts.end() && !it->second.loans.empty() && it->second.priced_at != now) mark_dirty( account.value );
+            flush();
+            const auto res = accounts.find( account.value );
+            if(res == accounts.end()) return std::nullopt;
+            return res->second.health;
+        }
+
+    private:
+        struct account_state {
+            vector<collateral_row>  collaterals;
+            vector<loan_row>        loans;
+            AccountHealth           health {};
+            uint64_t                priced_at = 0;      // loan interest projected to this time
+            bool                    dirty = false;
+        };
+
+        uint64_t                                                    reprice_interval;
+        uint64_t                                                    now;
+        uint64_t                                                    repriced_at;    // every borrower priced at or after this time
+        double                                                      max_rate = 0;   // highest yearly rate of any reserve or loan seen
+        std::unordered_map<uint64_t, pztoken_row>                   reserves;       // by pzname
+        std::unordered_map<uint64_t, account_state>                 accounts;
+        std::unordered_map<uint64_t, std::unordered_set<uint64_t>>  exposed;        // pzname => accounts with rows in it
+        std::set<pair<double, uint64_t>>                            by_health;      // accounts with loans
+        vector<uint64_t>                                            dirty;
+
+        template <typename T>
+        void set_row( vector<T>& rows, const T& row ) {
+            auto it = std::find_if(rows.begin(), rows.end(), [&](const T& r){ return r.id == row.id; });
+            if(it == rows.end()) rows.push_back( row );
+            else {
+                const name pzname = it->pzname;
+                *it = row;
+                if(pzname != row.pzname) unexpose( row.account, pzname );
+            }
+            exposed[row.pzname.value].insert( row.account.value );
+            mark_dirty( row.account.value );
+        }
+
+        template <typename T>
+        void erase_row( vector<T>& rows, const name account, const uint64_t id ) {
+            const auto it = std::find_if(rows.begin(), rows.end(), [&](const T& r){ return r.id == id; });
+            if(it == rows.end()) return;
+            const name pzname = it->pzname;
+            rows.erase( it );
+            unexpose( account, pzname );
+            mark_dirty( account.value );
+        }
+
+        // drop account from reverse index once it has no rows left in {pzname}
+        void unexpose( const name account, const name pzname ) {
+            const auto& state = accounts.at(account.value);
+            for(const auto& row: state.collaterals) if(row.pzname == pzname) return;
+            for(const auto& row: state.loans) if(row.pzname == pzname) return;
+            exposed[pzname.value].erase( account.value );
+        }
+
+        void set_rate( const asset& rate ) {
+            max_rate = std::max(max_rate, static_cast<double>(rate.amount) / static_cast<double>(pow10(rate.symbol.precision())));
+        }
+
+        void mark_dirty( const uint64_t account ) {
+            auto& state = accounts.at(account);
+            if(state.dirty) return;
+            state.dirty = true;
+            dirty.push_back( account );
+        }
+
+        const pztoken_row& get_reserve( const name pzname ) const {
+            const auto it = reserves.find( pzname.value );
+            check(it != reserves.end(), "pizzalend: HealthIndex: unknown reserve");
+            return it->second;
+        }
+
+        void flush() {
+            for(const uint64_t account: dirty) {
+                auto& state = accounts.at(account);
+                auto& health = state.health;
+                if(health.loan_value > 0) by_health.erase({ health.health_factor, account });
+
+                health = { name{ account }, 0, 0, 0, 0 };
+                for(const auto& row: state.collaterals) {
+                    const auto coll = get_collateral( row, get_reserve( row.pzname ) );
+                    health.collateral_value += coll.value;
+                    health.ratioed_value += coll.ratioed;
+                }
+                for(const auto& row: state.loans) {
+                    health.loan_value += get_loan( row, get_reserve( row.pzname ), now ).value;
+                }
+                health.health_factor = health.loan_value == 0 ? 0 : health.ratioed_value / health.loan_value;
+                state.priced_at = now;
+                state.dirty = false;
+
+                if(health.loan_value > 0) by_health.insert({ health.health_factor, account });
+                else if(state.collaterals.empty() && state.loans.empty()) accounts.erase( account );
+            }
+            dirty.clear();
+        }
+    };
+
+    struct PriceShock {
+        name        pzname;         // reserve, i.e. "pzeos"
+        double      multiplier;     // price multiplier, i.e. 0.8 = -20%
+    };
+
+    struct StressResult {
+        uint32_t    accounts;       // borrowers with health factor below 1 after the shock
+        double      loan_value;     // shocked loan value of those borrowers
+    };
+
+    // price shocks applied together, shocks on the same reserve compound
+    using StressScenario = vector<PriceShock>;
+
+    /**
+     * ## STRUCT `StressTest`
+     *
+     * Borrower positions laid out per reserve as contiguous columns of ratioed collateral value and loan value,
+     * so that a price shock is a few `axpy` passes over the shocked reserves' columns followed by one compare pass.
+     * Accounts without loans are left out since they can't be liquidated.
+     *
+     * ### example
+     *
+     * ```c++
+     * const pizzalend::StressTest stress( tables, reserves );
+     * const vector<pizzalend::StressScenario> scenarios = {
+     *     { { "pzeos"_n, 0.9 } },
+     *     { { "pzeos"_n, 0.7 } },
+     *     { { "pzusdt"_n, 0.95 }, { "pzusn"_n, 0.9 } }
+     * };
+     * const auto results = stress.run( scenarios );
+     * // => [{ 12, 5300.2 }, { 231, 80412.9 }, { 4, 102.5 }]
+     * ```
+     */
+    struct StressTest {
+        vector<name>    accounts;       // borrowers, same order as columns
+
+        StressTest( const MemoryTables& tables, const ReserveSnapshot& reserves ): pznames( reserves.rows.size() ),
+            collaterals( reserves.rows.size() ), loans( reserves.rows.size() )
+        {
+            for(size_t r = 0; r < reserves.rows.size(); ++r) pznames[r] = reserves.rows[r].pztoken;
+
+            // borrowers only: both tables are sorted by account
+            std::unordered_map<uint64_t, uint32_t> index;
+            for(const auto& row: tables.loans) {
+                if(index.emplace( row.account.value, uint32_t(accounts.size()) ).second) accounts.push_back( row.account );
+            }
+            base_collateral.assign( accounts.size(), 0 );
+            base_loan.assign( accounts.size(), 0 );
+
+            const uint64_t now = tables.now();
+            for(const auto& row: tables.loans) {
+                const size_t r = get_column( row.pzname );
+                const double value = get_loan( row, reserves.rows[r], now ).value;
+                add( loans[r], index.at(row.account.value), value );
+                base_loan[index.at(row.account.value)] += value;
+            }
+            for(const auto& row: tables.collaterals) {
+                const auto it = index.find( row.account.value );
+                if(it == index.end()) continue;
+                const size_t r = get_column( row.pzname );
+                const double value = get_collateral( row, reserves.rows[r] ).ratioed;
+                add( collaterals[r], it->second, value );
+                base_collateral[it->second] += value;
+            }
+        }
+
+        StressResult run( std::span<const PriceShock> scenario ) const {
+            vector<double> coll, loan;
+            return run( scenario, coll, loan );
+        }
+
+        vector<StressResult> run( std::span<const StressScenario> scenarios ) const {
+            vector<double> coll, loan;
+            vector<StressResult> res;
+            res.reserve( scenarios.size() );
+            for(const auto& scenario: scenarios) res.push_back( run( scenario, coll, loan ) );
+            return res;
+        }
+
+    private:
+        vector<name>            pznames;            // column => reserve
+        vector<vector<double>>  collaterals;        // [reserve][account] ratioed collateral value, empty if unused
+        vector<vector<double>>  loans;              // [reserve][account] loan value, empty if unused
+        vector<double>          base_collateral;    // [account] unshocked sums
+        vector<double>          base_loan;
+
+        size_t get_column( const name pzname ) const {
+            const auto it = std::lower_bound(pznames.begin(), pznames.end(), pzname);
+            check(it != pznames.end() && *it == pzname, "pizzalend: StressTest: unknown reserve");
+            return it - pznames.begin();
+        }
+
+        void add( vector<double>& column, const uint32_t account, const double value ) const {
+            if(column.empty()) column.assign( accounts.size(), 0 );
+            column[account] += value;
+        }
+
+        // coll += delta * column, vectorizes to packed multiply-adds
+        static void axpy( vector<double>& sums, const double delta, const vector<double>& column ) {
+            if(column.empty()) return;
+            double* __restrict out = sums.data();
+            const double* __restrict in = column.data();
+            for(size_t a = 0; a < sums.size(); ++a) out[a] += delta * in[a];
+        }
+
+        StressResult run( std::span<const PriceShock> scenario, vector<double>& coll, vector<double>& loan ) const {
+            coll.assign( base_collateral.begin(), base_collateral.end() );
+            loan.assign( base_loan.begin(), base_loan.end() );
+            // one pass per shocked reserve, with the product of its multipliers
+            for(auto shock = scenario.begin(); shock != scenario.end(); ++shock) {
+                const auto same = [&](const PriceShock& other){ return other.pzname == shock->pzname; };
+                if(std::any_of( scenario.begin(), shock, same )) continue;
+                double multiplier = 1;
+                for(auto it = shock; it != scenario.end(); ++it) if(same( *it )) multiplier *= it->multiplier;
+
+                const size_t r = get_column( shock->pzname );
+                axpy( coll, multiplier - 1, collaterals[r] );
+                axpy( loan, multiplier - 1, loans[r] );
+            }
+
+            uint32_t under = 0;
+            double value = 0;
+            for(size_t a = 0; a < coll.size(); ++a) {
+                const bool below = coll[a] < loan[a];
+                under += below;
+                value += below ? loan[a] : 0;
+            }
+            return { under, value };
+        }
+    };
+}
@@ -1,8 +1,26 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <span>
+#include <type_traits>
+
 #include <eosio/asset.hpp>
 #include <sx.utils/utils.hpp>
 
+// build with `-DPIZZALEND_INSTRUMENT` to count table reads per function (see `pizzalend::instrument`)
+#ifdef PIZZALEND_INSTRUMENT
+#include <eosio/print.hpp>
+#define PIZZALEND_SCOPE( function ) const pizzalend::instrument::Scope pizzalend_scope_( function )
+#define PIZZALEND_COUNT( counter, n ) pizzalend::instrument::count( &pizzalend::instrument::Counters::counter, n )
+#else
+#define PIZZALEND_SCOPE( function )
+#define PIZZALEND_COUNT( counter, n )
+#endif
+
 namespace pizzalend {
 
     using namespace eosio;
@@ -14,13 +32,175 @@ namespace pizzalend {
     const std::string description = "Lend.Pizza Converter";
     constexpr name token_code = "pztken.pizza"_n;
 
-    static const map<symbol_code, name> PZ_KEYS= {
-        { symbol_code{"PZUSDT"}, "pzusdt"_n },
-        { symbol_code{"USDT"}, "pzusdt"_n },
-        { symbol_code{"PZUSN"}, "pzusn"_n },
-        { symbol_code{"USN"}, "pzusn"_n },
-        { symbol_code{"PZOUSD"}, "pzousd"_n },
-        { symbol_code{"OUSD"}, "pzousd"_n }
+    struct pzkey {
+        name            pzname;
+        symbol_code     pzcode;
+        extended_symbol anchor;
+    };
+
+    // known reserves, resolved without table reads (pztokens share anchor precision)
+    // reserves whose anchor contract isn't pinned here (PZKEY, PZUSDC, PZUSDI...) resolve through the table scan
+    static constexpr pzkey PZ_KEYS[] = {
+        { "pzdfs"_n, symbol_code{"PZDFS"}, { symbol{"DFS", 4}, "minedfstoken"_n } },
+        { "pzeos"_n, symbol_code{"PZEOS"}, { symbol{"EOS", 4}, "eosio.token"_n } },
+        { "pzousd"_n, symbol_code{"PZOUSD"}, { symbol{"OUSD", 8}, "core.ogx"_n } },
+        { "pzusdt"_n, symbol_code{"PZUSDT"}, { symbol{"USDT", 4}, "tethertether"_n } },
+        { "pzusn"_n, symbol_code{"PZUSN"}, { symbol{"USN", 4}, "danchortoken"_n } }
+    };
+
+    /**
+     * ## STATIC `get_pzkey`
+     *
+     * Given pz-token or anchor symbol code return registry entry (or nullptr if reserve is not in `PZ_KEYS`)
+     *
+     * ### params
+     *
+     * - `{symbol_code} symcode` - pz-token or anchor symbol code
+     * - `{bool*} is_pz` - (optional) set to true if `symcode` is the pz-token side
+     *
+     * ### example
+     *
+     * ```c++
+     * bool is_pz;
+     * const auto key = pizzalend::get_pzkey( symbol_code{"USDT"}, &is_pz );
+     * // => key->pzname == "pzusdt", is_pz == false
+     * ```
+     */
+    static constexpr const pzkey* get_pzkey( const symbol_code symcode, bool* is_pz = nullptr ) {
+        for(const auto& key: PZ_KEYS) {
+            if(key.pzcode != symcode && key.anchor.get_symbol().code() != symcode) continue;
+            if(is_pz) *is_pz = key.pzcode == symcode;
+            return &key;
+        }
+        return nullptr;
+    }
+
+    // fixed-point values are integers in units of 10^-VALUE_PRECISION of the oracle price currency
+    constexpr uint8_t VALUE_PRECISION = 8;
+
+    static constexpr uint64_t POW10[] = {
+        1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL,
+        10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL, 100000000000000ULL,
+        1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+    };
+
+    // 10^exp for exp <= 38
+    static constexpr uint128_t pow10( const uint8_t exp ) {
+        return exp < 20 ? POW10[exp] : static_cast<uint128_t>(POW10[exp - 19]) * POW10[19];
+    }
+
+    static int64_t to_int64( const uint128_t value ) {
+        check(value <= static_cast<uint128_t>(std::numeric_limits<int64_t>::max()), "pizzalend: fixed-point overflow");
+        return static_cast<int64_t>(value);
+    }
+
+    // floor(a * b / c) with 128-bit intermediate product, all arguments non-negative
+    static int64_t mul_div( const int64_t a, const int64_t b, const uint128_t c ) {
+        return to_int64( static_cast<uint128_t>(a) * static_cast<uint128_t>(b) / c );
+    }
+
+    static double to_double( const int64_t value ) {
+        return static_cast<double>(value) / POW10[VALUE_PRECISION];
+    }
+
+    static int64_t to_value( const double value ) {
+        return static_cast<int64_t>(value * POW10[VALUE_PRECISION]);
+    }
+
+    /**
+     * ## STATIC `get_value`
+     *
+     * Given tokens and oracle price per whole token return fixed-point value
+     *
+     * ### example
+     *
+     * ```c++
+     * const int64_t value = pizzalend::get_value( asset{ 12345, symbol{"EOS",4} }, asset{ 35000, symbol{"USD",4} } );
+     * // => 432075000 (4.32075000)
+     * ```
+     */
+    static int64_t get_value( const asset& quantity, const asset& price ) {
+        const uint8_t precision = quantity.symbol.precision() + price.symbol.precision();
+        const uint128_t product = static_cast<uint128_t>(quantity.amount) * static_cast<uint128_t>(price.amount);
+        if(precision >= VALUE_PRECISION) return to_int64( product / pow10(precision - VALUE_PRECISION) );
+        return to_int64( product * pow10(VALUE_PRECISION - precision) );
+    }
+
+    // fixed-point value => amount of {sym} tokens at oracle {price}, rounded down
+    static int64_t get_amount( const int64_t value, const asset& price, const symbol& sym ) {
+        const uint8_t precision = sym.precision() + price.symbol.precision();
+        check(precision <= VALUE_PRECISION + 19, "pizzalend: get_amount(): precision overflow");
+        if(precision >= VALUE_PRECISION) return mul_div( value, POW10[precision - VALUE_PRECISION], price.amount );
+        return to_int64( static_cast<uint128_t>(value) / (static_cast<uint128_t>(price.amount) * POW10[VALUE_PRECISION - precision]) );
+    }
+
+    // value multiplied by a ratio stored as asset, i.e. "0.8000 X" => 80%
+    static int64_t apply_rate( const int64_t value, const asset& rate ) {
+        return mul_div( value, rate.amount, POW10[rate.symbol.precision()] );
+    }
+
+    /**
+     * ## STRUCT `PzPrice`
+     *
+     * `pzprice` decoded from its IEEE-754 bits so that `pzprice == mantissa * 2^exponent` exactly.
+     * Wrapping and unwrapping become exact 128-bit integer operations rounded down, instead of double
+     * products that lose precision above 2^53.
+     */
+    struct PzPrice {
+        uint64_t    mantissa;
+        int32_t     exponent;
+
+        static PzPrice from_double( const double pzprice ) {
+            uint64_t bits;
+            memcpy(&bits, &pzprice, sizeof(bits));
+            const int32_t biased = (bits >> 52) & 0x7ff;
+            check((bits >> 63) == 0 && biased != 0x7ff, "pizzalend: invalid pzprice");
+
+            PzPrice res = biased == 0 ? PzPrice{ bits & ((1ULL << 52) - 1), -1074 }
+                                      : PzPrice{ (bits & ((1ULL << 52) - 1)) | (1ULL << 52), biased - 1075 };
+            while(res.mantissa && !(res.mantissa & 1)) { res.mantissa >>= 1; ++res.exponent; }
+            return res;
+        }
+
+        // floor(amount * pzprice)
+        int64_t mul( const int64_t amount ) const {
+            const uint128_t product = static_cast<uint128_t>(amount) * mantissa;
+            if(exponent >= 0) {
+                check(exponent < 64 && product <= (static_cast<uint128_t>(std::numeric_limits<int64_t>::max()) >> exponent), "pizzalend: fixed-point overflow");
+                return to_int64( product << exponent );
+            }
+            return -exponent >= 128 ? 0 : to_int64( product >> -exponent );
+        }
+
+        // ceil(amount * pzprice)
+        int64_t mul_ceil( const int64_t amount ) const {
+            if(exponent >= 0) return mul( amount );
+            const uint128_t product = static_cast<uint128_t>(amount) * mantissa;
+            if(-exponent >= 128) return product ? 1 : 0;
+            const uint128_t rem = product & ((static_cast<uint128_t>(1) << -exponent) - 1);
+            return to_int64( (product >> -exponent) + (rem ? 1 : 0) );
+        }
+
+        // floor(amount / pzprice)
+        int64_t div( const int64_t amount ) const {
+            const auto [ num, den ] = get_quotient( amount );
+            return den == 0 ? 0 : to_int64( num / den );
+        }
+
+        // ceil(amount / pzprice)
+        int64_t div_ceil( const int64_t amount ) const {
+            const auto [ num, den ] = get_quotient( amount );
+            return den == 0 ? (amount ? 1 : 0) : to_int64( num / den + (num % den ? 1 : 0) );
+        }
+
+    private:
+        // amount / pzprice as integer fraction (den == 0 if pzprice exceeds any amount)
+        pair<uint128_t, uint128_t> get_quotient( const int64_t amount ) const {
+            check(mantissa != 0, "pizzalend: zero pzprice");
+            if(exponent >= 0) return { amount, exponent >= 64 ? 0 : static_cast<uint128_t>(mantissa) << exponent };
+            check(-exponent <= 64, "pizzalend: pzprice out of range");
+            return { static_cast<uint128_t>(amount) << -exponent, mantissa };
+        }
     };
 
     struct pztoken_config {
@@ -133,52 +313,582 @@ namespace pizzalend {
     };
     typedef eosio::multi_index< "liqdtorder"_n, liqdtorder_row > liqdtorder;
 
-    static bool is_pztoken( const symbol& sym ) {
-        return utils::get_supply({ sym, token_code }).symbol.is_valid();
+    // `lend.pizza` row timestamps (`updated_at`, `last_calculated_at`...) are seconds since epoch, like `now()`
+    constexpr uint64_t SECONDS_PER_YEAR = 365 * 24 * 60 * 60;
+
+#ifdef PIZZALEND_INSTRUMENT
+    /**
+     * ## NAMESPACE `instrument`
+     *
+     * Table read counters, compiled in only with `-DPIZZALEND_INSTRUMENT` (otherwise the macros expand to nothing).
+     * Reads are attributed to the innermost public function being executed.
+     *
+     * ### example
+     *
+     * ```c++
+     * [[eosio::action, eosio::read_only]]
+     * vector<pizzalend::instrument::FunctionCost> stats() {
+     *     pizzalend::instrument::reset();
+     *     pizzalend::get_liquidation_out( ext_in, ext_sym_out, loans, collaterals );
+     *     pizzalend::instrument::print();
+     *     return pizzalend::instrument::get_costs();
+     *     // => [{ "get_liquidation_out", 1, { 0, 0, 0, 0 } }, { "ReserveSnapshot", 1, { 1, 0, 12, 12 } }]
+     * }
+     * ```
+     */
+    namespace instrument {
+        struct Counters {
+            uint32_t    tables = 0;         // multi_index constructions
+            uint32_t    lookups = 0;        // get / find / lower_bound calls
+            uint32_t    scanned = 0;        // rows iterated in linear scans
+            uint32_t    decoded = 0;        // rows deserialized
+        };
+
+        struct FunctionCost {
+            std::string function;
+            uint32_t    calls = 0;
+            Counters    counters;
+        };
+
+        struct Stats {
+            Counters    total;
+            std::array<FunctionCost, 32> functions;
+            uint32_t    size = 0;
+            FunctionCost* current = nullptr;
+        };
+
+        inline Stats stats;
+
+        inline void count( uint32_t Counters::* counter, const uint32_t n ) {
+            stats.total.*counter += n;
+            if(stats.current) stats.current->counters.*counter += n;
+        }
+
+        struct Scope {
+            FunctionCost* parent;
+
+            explicit Scope( const char* function ): parent( stats.current ) {
+                uint32_t i = 0;
+                while(i < stats.size && stats.functions[i].function != function) ++i;
+                check(i < stats.functions.size(), "pizzalend: instrument: too many functions");
+                if(i == stats.size) stats.functions[stats.size++].function = function;
+                stats.current = &stats.functions[i];
+                ++stats.current->calls;
+            }
+            ~Scope() { stats.current = parent; }
+        };
+
+        inline void reset() { stats = {}; }
+
+        inline vector<FunctionCost> get_costs() {
+            return { stats.functions.begin(), stats.functions.begin() + stats.size };
+        }
+
+        inline void print() {
+            for(uint32_t i = 0; i < stats.size; ++i) {
+                const auto& [ function, calls, c ] = stats.functions[i];
+                eosio::print( function, ": calls=", calls, " tables=", c.tables, " lookups=", c.lookups, " scanned=", c.scanned, " decoded=", c.decoded, "\n" );
+            }
+            const auto& c = stats.total;
+            eosio::print( "total: tables=", c.tables, " lookups=", c.lookups, " scanned=", c.scanned, " decoded=", c.decoded, "\n" );
+        }
     }
+#endif
 
-    static extended_symbol get_pztoken( const symbol_code& symcode) {
-        pztoken pztoken_tbl( code, code.value);
-        for(const auto& row: pztoken_tbl) {
-            if(row.anchor.get_symbol().code() == symcode) {
-                return row.pzsymbol;
+    // inline capacity for per-account positions (one per reserve)
+    constexpr size_t MAX_POSITIONS = 16;
+
+    /**
+     * ## STRUCT `SmallVector`
+     *
+     * Vector storing up to {N} elements inline (no heap allocation), spilling to the heap only beyond that.
+     * Converts to `std::span` for the aggregate functions.
+     */
+    template <typename T, size_t N>
+    struct SmallVector {
+        SmallVector() = default;
+        SmallVector( const SmallVector& other ) { for(const auto& item: other) push_back(item); }
+        SmallVector& operator=( const SmallVector& other ) { if(this != &other) { clear(); for(const auto& item: other) push_back(item); } return *this; }
+
+        void push_back( const T& item ) {
+            if(heap.empty() && count < N) {
+                inline_items[count++] = item;
+                return;
             }
+            if(heap.empty()) heap.assign(inline_items.begin(), inline_items.end());
+            heap.push_back(item);
+            ++count;
+        }
+
+        void clear() { heap.clear(); count = 0; }
+
+        T* data() { return heap.empty() ? inline_items.data() : heap.data(); }
+        const T* data() const { return heap.empty() ? inline_items.data() : heap.data(); }
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+
+        T& operator[]( const size_t i ) { return data()[i]; }
+        const T& operator[]( const size_t i ) const { return data()[i]; }
+        T& back() { return data()[count - 1]; }
+        const T& back() const { return data()[count - 1]; }
+
+        T* begin() { return data(); }
+        T* end() { return data() + count; }
+        const T* begin() const { return data(); }
+        const T* end() const { return data() + count; }
+
+        operator std::span<const T>() const { return { data(), count }; }
+        operator vector<T>() const { return { begin(), end() }; }
+
+    private:
+        std::array<T, N>    inline_items {};
+        vector<T>           heap;
+        size_t              count = 0;
+    };
+
+    // serialized size of a fixed-size `pztoken_row` field type
+    template <typename T>
+    static constexpr uint32_t get_packed_size() {
+        if constexpr (std::is_same_v<T, name> || std::is_same_v<T, symbol>) return sizeof(uint64_t);
+        else if constexpr (std::is_same_v<T, extended_symbol>) return get_packed_size<symbol>() + get_packed_size<name>();
+        else if constexpr (std::is_same_v<T, asset>) return sizeof(int64_t) + get_packed_size<symbol>();
+        else {
+            static_assert( std::is_arithmetic_v<T>, "pizzalend: get_packed_size(): unsupported type" );
+            return sizeof(T);
         }
-        return {};
     }
 
-    static pztoken_row get_reserve( const extended_symbol& anchor_ext_sym) {
-        pztoken pztoken_tbl( code, code.value);
-        for(const auto& row: pztoken_tbl) {
-            if(row.anchor == anchor_ext_sym) {
-                return row;
+    /**
+     * ## STRUCT `pztoken_view`
+     *
+     * Partial view of a raw `pztoken` row read through the primary iterator. Fields are decoded on access
+     * from their fixed offsets in the serialized row, and only the bytes up to the furthest field touched are copied.
+     * Use it for scans that compare a few fields, and `row()` to decode the full row once it matches.
+     *
+     * ### example
+     *
+     * ```c++
+     * pizzalend::pztoken_view::for_each([&](const pizzalend::pztoken_view& view) {
+     *     if(view.anchor() != ext_sym) return true;
+     *     reserve = view.row();
+     *     return false;
+     * });
+     * ```
+     */
+    struct pztoken_view {
+        // byte offsets of `pztoken_row` fields in the serialized row: sum of the packed sizes of the fields before them
+        static constexpr uint32_t PZTOKEN = 0;
+        static constexpr uint32_t PZSYMBOL = PZTOKEN + get_packed_size<name>();
+        static constexpr uint32_t ANCHOR = PZSYMBOL + get_packed_size<extended_symbol>();
+        static constexpr uint32_t AVAILABLE_DEPOSIT = ANCHOR + get_packed_size<extended_symbol>() + get_packed_size<asset>();    // after cumulative_deposit
+        static constexpr uint32_t PRICE = AVAILABLE_DEPOSIT + 9 * get_packed_size<asset>();    // available_deposit to discount_rate
+        static constexpr uint32_t PZPRICE = PRICE + get_packed_size<asset>();
+        static constexpr uint32_t PZPRICE_RATE = PZPRICE + get_packed_size<double_t>();
+        static constexpr uint32_t UPDATED_AT = PZPRICE_RATE + get_packed_size<double_t>();
+        static constexpr uint32_t CONFIG = UPDATED_AT + get_packed_size<uint64_t>();
+        static constexpr uint32_t LIQDT_RATE = CONFIG + 7 * get_packed_size<asset>();          // base_rate to fixed_fee_rate
+        static constexpr uint32_t LIQDT_BONUS = LIQDT_RATE + get_packed_size<asset>();
+        static constexpr uint32_t MAX_LTV = LIQDT_BONUS + get_packed_size<asset>();
+        static constexpr uint32_t SIZE = MAX_LTV + 2 * get_packed_size<asset>() + 2 * get_packed_size<bool>() + 2 * get_packed_size<uint8_t>();
+
+        // no padding up to `config.collateral_liqdt_order`, so the serialized offsets match the struct declarations
+        static_assert( offsetof(pztoken_row, available_deposit) == AVAILABLE_DEPOSIT && offsetof(pztoken_row, price) == PRICE );
+        static_assert( offsetof(pztoken_row, pzprice) == PZPRICE && offsetof(pztoken_row, updated_at) == UPDATED_AT && offsetof(pztoken_row, config) == CONFIG );
+        static_assert( CONFIG + offsetof(pztoken_config, liqdt_rate) == LIQDT_RATE && CONFIG + offsetof(pztoken_config, max_ltv) == MAX_LTV );
+        static_assert( CONFIG + offsetof(pztoken_config, collateral_liqdt_order) + get_packed_size<uint8_t>() == SIZE );
+
+        explicit pztoken_view( const int32_t itr ): itr( itr ) {}
+
+        name pzname() const { return name{ read<uint64_t>(PZTOKEN) }; }
+        extended_symbol pzsymbol() const { return read_extended_symbol(PZSYMBOL); }
+        extended_symbol anchor() const { return read_extended_symbol(ANCHOR); }
+        symbol pzsymbol_symbol() const { return read_symbol(PZSYMBOL); }
+        symbol anchor_symbol() const { return read_symbol(ANCHOR); }
+        asset available_deposit() const { return read_asset(AVAILABLE_DEPOSIT); }
+        asset price() const { return read_asset(PRICE); }
+        double pzprice() const { return read<double>(PZPRICE); }
+        double pzprice_rate() const { return read<double>(PZPRICE_RATE); }
+        uint64_t updated_at() const { return read<uint64_t>(UPDATED_AT); }
+        asset liqdt_rate() const { return read_asset(LIQDT_RATE); }
+        asset liqdt_bonus() const { return read_asset(LIQDT_BONUS); }
+        asset max_ltv() const { return read_asset(MAX_LTV); }
+
+        // decode the full row
+        pztoken_row row() const {
+            PIZZALEND_COUNT( decoded, 1 );
+            const uint32_t size = internal_use_do_not_use::db_get_i64( itr, nullptr, 0 );
+            vector<char> bytes( size );
+            internal_use_do_not_use::db_get_i64( itr, bytes.data(), size );
+            return unpack<pztoken_row>( bytes.data(), size );
+        }
+
+        // calls {f} with every row in primary key order until it returns false
+        template <typename F>
+        static void for_each( F&& f ) {
+            PIZZALEND_COUNT( lookups, 1 );
+            uint64_t primary = 0;
+            for(int32_t itr = internal_use_do_not_use::db_lowerbound_i64( code.value, code.value, "pztoken"_n.value, 0 ); itr >= 0; itr = internal_use_do_not_use::db_next_i64( itr, &primary )) {
+                PIZZALEND_COUNT( scanned, 1 );
+                if(!f( pztoken_view{ itr } )) return;
             }
         }
-        check(false, "pizzalend::get_reserve(): anchor doesn't exist");
-        return {};
+
+        static std::optional<pztoken_view> find( const name pzname ) {
+            PIZZALEND_COUNT( lookups, 1 );
+            const int32_t itr = internal_use_do_not_use::db_find_i64( code.value, code.value, "pztoken"_n.value, pzname.value );
+            if(itr < 0) return std::nullopt;
+            return pztoken_view{ itr };
+        }
+
+    private:
+        int32_t             itr;
+        mutable uint32_t    loaded = 0;
+        mutable char        data[SIZE];
+
+        template <typename T>
+        T read( const uint32_t offset ) const {
+            if(loaded < offset + sizeof(T)) {
+                // copy the row prefix up to and including this field
+                loaded = offset + sizeof(T);
+                check(internal_use_do_not_use::db_get_i64( itr, data, loaded ) >= int32_t(loaded), "pizzalend: pztoken_view: row too short");
+            }
+            T value;
+            memcpy(&value, data + offset, sizeof(T));
+            return value;
+        }
+
+        symbol read_symbol( const uint32_t offset ) const { return symbol{ read<uint64_t>(offset) }; }
+        asset read_asset( const uint32_t offset ) const { return { read<int64_t>(offset), read_symbol(offset + 8) }; }
+        extended_symbol read_extended_symbol( const uint32_t offset ) const { return { read_symbol(offset), name{ read<uint64_t>(offset + 8) } }; }
+    };
+
+    /**
+     * ## STRUCT `ChainTables`
+     *
+     * Default table backend reading `lend.pizza` tables through `eosio::multi_index`.
+     *
+     * Any type with the same members can be passed as `tables` to functions that read positions,
+     * i.e. `MemoryTables` to run the same logic natively against exported rows.
+     */
+    struct ChainTables {
+        template <typename F>
+        void for_each_reserve( F&& f ) const {
+            pztoken pztoken_tbl( code, code.value );
+            PIZZALEND_COUNT( tables, 1 );
+            for(const auto& row: pztoken_tbl) {
+                PIZZALEND_COUNT( scanned, 1 );
+                PIZZALEND_COUNT( decoded, 1 );
+                f(row);
+            }
+        }
+
+        template <typename F>
+        void for_each_collateral( const name account, F&& f ) const {
+            collateral_table collateral_tbl( code, code.value );
+            auto index = collateral_tbl.get_index<"byaccount"_n>();
+            PIZZALEND_COUNT( tables, 1 );
+            PIZZALEND_COUNT( lookups, 1 );
+            for(auto it = index.lower_bound(account.value); it != index.end() && it->account == account; ++it) {
+                PIZZALEND_COUNT( decoded, 1 );
+                f(*it);
+            }
+        }
+
+        template <typename F>
+        void for_each_loan( const name account, F&& f ) const {
+            loan_table loan_tbl( code, code.value );
+            auto index = loan_tbl.get_index<"byaccount"_n>();
+            PIZZALEND_COUNT( tables, 1 );
+            PIZZALEND_COUNT( lookups, 1 );
+            for(auto it = index.lower_bound(account.value); it != index.end() && it->account == account; ++it) {
+                PIZZALEND_COUNT( decoded, 1 );
+                f(*it);
+            }
+        }
+
+        // calls {f} from {start_id} until it returns false, returns true if the end of table was reached
+        template <typename F>
+        bool for_each_liqdtorder( const uint64_t start_id, F&& f ) const {
+            liqdtorder liqdtordertbl( code, code.value );
+            PIZZALEND_COUNT( tables, 1 );
+            PIZZALEND_COUNT( lookups, 1 );
+            for(auto it = liqdtordertbl.lower_bound(start_id); it != liqdtordertbl.end(); ++it) {
+                PIZZALEND_COUNT( scanned, 1 );
+                PIZZALEND_COUNT( decoded, 1 );
+                if(!f(*it)) return false;
+            }
+            return true;
+        }
+
+        // seconds since epoch used to project loan interest
+        uint64_t now() const {
+            return current_time_point().sec_since_epoch();
+        }
+
+        std::optional<cachedhealth_row> get_cachedhealth( const name account ) const {
+            cachedhealth_table cachedhealth_tbl( code, code.value );
+            PIZZALEND_COUNT( tables, 1 );
+            PIZZALEND_COUNT( lookups, 1 );
+            const auto it = cachedhealth_tbl.find( account.value );
+            if(it == cachedhealth_tbl.end()) return std::nullopt;
+            PIZZALEND_COUNT( decoded, 1 );
+            return *it;
+        }
+    };
+
+    /**
+     * ## STRUCT `MemoryTables`
+     *
+     * In-memory table backend loaded from exported rows (i.e. a local state dump), ordered the same way
+     * as the on-chain primary and `byaccount` indexes so that results match `ChainTables`.
+     *
+     * ### example
+     *
+     * ```c++
+     * const pizzalend::MemoryTables tables( pztoken_rows, collateral_rows, loan_rows, liqdtorder_rows, cachedhealth_rows );
+     * const pizzalend::ReserveSnapshot reserves( tables );
+     *
+     * const double health_factor = pizzalend::get_health_factor( "myusername"_n, reserves, tables );
+     * // => 1.2345
+     * ```
+     */
+    struct MemoryTables {
+        vector<pztoken_row>         reserves;       // by pztoken
+        vector<collateral_row>      collaterals;    // by account, id
+        vector<loan_row>            loans;          // by account, id
+        vector<liqdtorder_row>      liqdtorders;    // by id
+        vector<cachedhealth_row>    cachedhealths;  // by account
+        uint64_t                    time = 0;       // snapshot time in seconds since epoch, 0 = don't project loan interest
+
+        MemoryTables() = default;
+
+        MemoryTables( vector<pztoken_row> reserves, vector<collateral_row> collaterals, vector<loan_row> loans,
+                      vector<liqdtorder_row> liqdtorders = {}, vector<cachedhealth_row> cachedhealths = {} )
+            : reserves( std::move(reserves) ), collaterals( std::move(collaterals) ), loans( std::move(loans) ),
+              liqdtorders( std::move(liqdtorders) ), cachedhealths( std::move(cachedhealths) )
+        {
+            sort();
+        }
+
+        // restore index order after rows were modified in place
+        void sort() {
+            const auto by_account = [](const auto& a, const auto& b){ return std::tie(a.account.value, a.id) < std::tie(b.account.value, b.id); };
+            std::sort(reserves.begin(), reserves.end(), [](const pztoken_row& a, const pztoken_row& b){ return a.pztoken < b.pztoken; });
+            std::sort(collaterals.begin(), collaterals.end(), by_account);
+            std::sort(loans.begin(), loans.end(), by_account);
+            std::sort(liqdtorders.begin(), liqdtorders.end(), [](const liqdtorder_row& a, const liqdtorder_row& b){ return a.id < b.id; });
+            std::sort(cachedhealths.begin(), cachedhealths.end(), [](const cachedhealth_row& a, const cachedhealth_row& b){ return a.account < b.account; });
+        }
+
+        template <typename F>
+        void for_each_reserve( F&& f ) const {
+            for(const auto& row: reserves) f(row);
+        }
+
+        template <typename F>
+        void for_each_collateral( const name account, F&& f ) const {
+            for(auto it = lower_bound_account(collaterals, account); it != collaterals.end() && it->account == account; ++it) f(*it);
+        }
+
+        template <typename F>
+        void for_each_loan( const name account, F&& f ) const {
+            for(auto it = lower_bound_account(loans, account); it != loans.end() && it->account == account; ++it) f(*it);
+        }
+
+        template <typename F>
+        bool for_each_liqdtorder( const uint64_t start_id, F&& f ) const {
+            auto it = std::lower_bound(liqdtorders.begin(), liqdtorders.end(), start_id, [](const liqdtorder_row& row, const uint64_t id){ return row.id < id; });
+            for(; it != liqdtorders.end(); ++it)
+                if(!f(*it)) return false;
+            return true;
+        }
+
+        uint64_t now() const {
+            return time;
+        }
+
+        std::optional<cachedhealth_row> get_cachedhealth( const name account ) const {
+            const auto it = lower_bound_account(cachedhealths, account);
+            if(it == cachedhealths.end() || it->account != account) return std::nullopt;
+            return *it;
+        }
+
+    private:
+        template <typename T>
+        static typename vector<T>::const_iterator lower_bound_account( const vector<T>& rows, const name account ) {
+            return std::lower_bound(rows.begin(), rows.end(), account.value, [](const T& row, const uint64_t value){ return row.account.value < value; });
+        }
+    };
+
+    /**
+     * ## STRUCT `ReserveSnapshot`
+     *
+     * All `pztoken` reserves loaded with a single table read, with compact keys for lookups
+     * by pzname, anchor and pzsymbol. Pass it to the overloads below to avoid re-reading `pztoken` on every call.
+     *
+     * ### example
+     *
+     * ```c++
+     * const pizzalend::ReserveSnapshot reserves;
+     * const auto out1 = pizzalend::wrap( asset{ 10000, symbol{"USDT",4} }, reserves );
+     * const auto out2 = pizzalend::unwrap( asset{ 10000, symbol{"PZEOS",4} }, reserves );
+     * ```
+     */
+    struct ReserveSnapshot {
+        struct keys {
+            uint64_t        pzname;
+            symbol          pzsymbol;
+            extended_symbol anchor;
+        };
+
+        vector<pztoken_row> rows;       // in primary key (pzname) order
+        vector<keys>        index;      // same order as rows
+        uint64_t            updated_at = 0;     // latest reserve update, seconds since epoch
+
+        ReserveSnapshot(): ReserveSnapshot( ChainTables{} ) {}
+
+        template <typename Tables>
+        explicit ReserveSnapshot( const Tables& tables ) {
+            PIZZALEND_SCOPE( "ReserveSnapshot" );
+            tables.for_each_reserve([&](const pztoken_row& row){ rows.push_back(row); });
+            build_index();
+        }
+
+        explicit ReserveSnapshot( vector<pztoken_row> reserves ): rows( std::move(reserves) ) {
+            std::sort(rows.begin(), rows.end(), [](const pztoken_row& a, const pztoken_row& b){ return a.pztoken < b.pztoken; });
+            build_index();
+        }
+
+        const pztoken_row* by_pzname( const name pzname ) const {
+            const auto it = std::lower_bound(index.begin(), index.end(), pzname.value, [](const keys& k, const uint64_t v){ return k.pzname < v; });
+            return it == index.end() || it->pzname != pzname.value ? nullptr : &rows[it - index.begin()];
+        }
+
+        const pztoken_row* by_anchor( const extended_symbol& anchor ) const {
+            for(size_t i = 0; i < index.size(); ++i)
+                if(index[i].anchor == anchor) return &rows[i];
+            return nullptr;
+        }
+
+        const pztoken_row* by_anchor( const symbol& sym ) const {
+            for(size_t i = 0; i < index.size(); ++i)
+                if(index[i].anchor.get_symbol() == sym) return &rows[i];
+            return nullptr;
+        }
+
+        const pztoken_row* by_anchor( const symbol_code& symcode ) const {
+            for(size_t i = 0; i < index.size(); ++i)
+                if(index[i].anchor.get_symbol().code() == symcode) return &rows[i];
+            return nullptr;
+        }
+
+        const pztoken_row* by_pzsymbol( const symbol& sym ) const {
+            for(size_t i = 0; i < index.size(); ++i)
+                if(index[i].pzsymbol == sym) return &rows[i];
+            return nullptr;
+        }
+
+        // latest update of reserves {pznames} (all reserves if empty), unknown pznames count as updated now
+        uint64_t get_updated_at( std::span<const name> pznames ) const {
+            if(pznames.empty()) return updated_at;
+            uint64_t res = 0;
+            for(const name pzname: pznames) {
+                const auto row = by_pzname(pzname);
+                if(row == nullptr) return std::numeric_limits<uint64_t>::max();
+                res = std::max(res, row->updated_at);
+            }
+            return res;
+        }
+
+    private:
+        void build_index() {
+            index.reserve(rows.size());
+            for(const auto& row: rows) {
+                index.push_back({ row.pztoken.value, row.pzsymbol.get_symbol(), row.anchor });
+                updated_at = std::max(updated_at, row.updated_at);
+            }
+        }
+    };
+
+    static bool is_pztoken( const symbol& sym ) {
+        bool is_pz = false;
+        if( const auto key = get_pzkey(sym.code(), &is_pz) )
+            return is_pz && key->anchor.get_symbol().precision() == sym.precision();
+
+        return utils::get_supply({ sym, token_code }).symbol.is_valid();
+    }
+
+    static extended_symbol get_pztoken( const symbol_code& symcode) {
+        PIZZALEND_SCOPE( "get_pztoken" );
+        extended_symbol res;
+        pztoken_view::for_each([&](const pztoken_view& view) {
+            if(view.anchor_symbol().code() != symcode) return true;
+            res = view.pzsymbol();
+            return false;
+        });
+        return res;
+    }
+
+    static extended_symbol get_pztoken( const symbol_code& symcode, const ReserveSnapshot& reserves ) {
+        const auto row = reserves.by_anchor(symcode);
+        return row ? row->pzsymbol : extended_symbol{};
+    }
+
+    static pztoken_row get_reserve( const extended_symbol& anchor_ext_sym) {
+        PIZZALEND_SCOPE( "get_reserve" );
+        std::optional<pztoken_row> res;
+        pztoken_view::for_each([&](const pztoken_view& view) {
+            if(view.anchor() != anchor_ext_sym) return true;
+            res = view.row();
+            return false;
+        });
+        check(res.has_value(), "pizzalend::get_reserve(): anchor doesn't exist");
+        return *res;
+    }
+
+    static const pztoken_row& get_reserve( const extended_symbol& anchor_ext_sym, const ReserveSnapshot& reserves ) {
+        const auto row = reserves.by_anchor(anchor_ext_sym);
+        check(row != nullptr, "pizzalend::get_reserve(): anchor doesn't exist");
+        return *row;
     }
 
     static asset get_available_deposit( const symbol& sym) {
-        pztoken pztoken_tbl(code, code.value);
+        PIZZALEND_SCOPE( "get_available_deposit" );
 
         // if we know pztoken name - use primary key for speed
-        if( PZ_KEYS.count(sym.code()) ){
-            const auto& row = pztoken_tbl.get( PZ_KEYS.at(sym.code()).value, "pizzalend::get_available_deposit: not redeemable");
-            return row.available_deposit;
+        if( const auto key = get_pzkey(sym.code()) ){
+            const auto view = pztoken_view::find( key->pzname );
+            check(view.has_value(), "pizzalend::get_available_deposit: not redeemable");
+            return view->available_deposit();
         }
 
         check(false, "pizzalend::get_available_deposit: not redeemable: " + sym.code().to_string());
         return { };
     }
 
+    static asset get_available_deposit( const symbol& sym, const ReserveSnapshot& reserves ) {
+        const auto row = reserves.by_pzsymbol(sym);
+        check(row != nullptr, "pizzalend::get_available_deposit: not redeemable: " + sym.code().to_string());
+        return row->available_deposit;
+    }
+
     static extended_symbol get_anchor( const name pzname) {
-        pztoken pztoken_tbl( code, code.value);
-        const auto it = pztoken_tbl.find( pzname.value );
-        return it == pztoken_tbl.end() ? extended_symbol{} : it->anchor;
+        PIZZALEND_SCOPE( "get_anchor" );
+        const auto view = pztoken_view::find( pzname );
+        return view ? view->anchor() : extended_symbol{};
+    }
+
+    static extended_symbol get_anchor( const name pzname, const ReserveSnapshot& reserves ) {
+        const auto row = reserves.by_pzname(pzname);
+        return row ? row->anchor : extended_symbol{};
     }
 
     static liqdtorder_row get_auction( const uint64_t id ){
+        PIZZALEND_SCOPE( "get_auction" );
         liqdtorder liqdtordertbl( code, code.value );
+        PIZZALEND_COUNT( tables, 1 );
+        PIZZALEND_COUNT( lookups, 1 );
+        PIZZALEND_COUNT( decoded, 1 );
         //return {93, "nfq111111111"_n, {asset{	900109'9377, symbol{"PZKEY",4}}, "pztken.pizza"_n}, {asset{166'7878, symbol{"USDT",4}}, "tethertether"_n} };
         //return {94, "zhuyifei1235"_n, {asset{464683025, symbol{"PZKEY",4}}, "pztken.pizza"_n}, {asset{164018, symbol{"USDT",4}}, "tethertether"_n} };
         //return {93, "12345goldman"_n, {asset{18995'6975, symbol{"PZKEY",4}}, "pztken.pizza"_n}, {asset{6'7048, symbol{"USDT",4}}, "tethertether"_n} };
@@ -189,100 +899,408 @@ namespace pizzalend {
         return liqdtordertbl.get(id, "pizzalend: can't find auction");
     }
 
+    // collateral symbols containing this code are AIR lp tokens and can't be liquidated
+    constexpr symbol_code LIQ_EXCLUDED_CODE = symbol_code{"PZUSDI"};
+
+    // substring match on raw symbol code bytes, no string allocation
+    static constexpr bool contains_code( const symbol_code symcode, const symbol_code part ) {
+        const uint32_t len = part.length();
+        const uint64_t mask = len >= 8 ? ~0ULL : (1ULL << (8 * len)) - 1;
+        for(uint32_t shift = 0; shift + len <= 7; ++shift) {
+            if(((symcode.raw() >> (8 * shift)) & mask) == part.raw()) return true;
+        }
+        return false;
+    }
+
+    /**
+     * ## STRUCT `ReservePrices`
+     *
+     * Oracle price per smallest anchor unit for every reserve, built once from a `ReserveSnapshot`
+     */
+    struct ReservePrices {
+        vector<pair<extended_symbol, asset>> prices;        // sorted by anchor
+
+        explicit ReservePrices( const ReserveSnapshot& reserves ) {
+            prices.reserve(reserves.rows.size());
+            for(const auto& row: reserves.rows) prices.push_back({ row.anchor, row.price });
+            std::sort(prices.begin(), prices.end(), [](const pair<extended_symbol, asset>& a, const pair<extended_symbol, asset>& b){ return a.first < b.first; });
+        }
+
+        // fixed-point value of {ext_tokens}
+        int64_t get_value( const extended_asset& ext_tokens ) const {
+            const auto ext_sym = ext_tokens.get_extended_symbol();
+            const auto it = std::lower_bound(prices.begin(), prices.end(), ext_sym, [](const pair<extended_symbol, asset>& p, const extended_symbol& s){ return p.first < s; });
+            check(it != prices.end() && it->first == ext_sym, "pizzalend: ReservePrices: anchor doesn't exist");
+            return pizzalend::get_value( ext_tokens.quantity, it->second );
+        }
+    };
+
+    struct LiqOrder {
+        liqdtorder_row  order;
+        double          value;          // oraclized value of the loan to liquidate
+    };
+
+    struct LiqScan {
+        vector<LiqOrder>    orders;     // sorted by value, highest first
+        uint64_t            next_id;    // pass as `start_id` to resume
+        bool                done;       // true when the end of `liqdtorder` was reached
+    };
+
+    /**
+     * ## STATIC `scan_liq_accounts`
+     *
+     * Scan at most {max_rows} rows of `liqdtorder` starting from {start_id} and return orders worth more than {min_value}
+     *
+     * ### params
+     *
+     * - `{double} min_value` - minimum loan value to liquidate
+     * - `{uint64_t} start_id` - first order id to scan (`next_id` of the previous page)
+     * - `{uint32_t} max_rows` - maximum number of rows to scan in this call, at least 1
+     * - `{ReserveSnapshot} reserves` - reserves snapshot
+     *
+     * ### example
+     *
+     * ```c++
+     * const pizzalend::ReserveSnapshot reserves;
+     * const auto page = pizzalend::scan_liq_accounts( 10, 0, 200, reserves );
+     * // => { orders: [{ order, 1200.5 }, { order, 15.2 }], next_id: 231, done: false }
+     * ```
+     */
+    template <typename Tables = ChainTables>
+    static LiqScan scan_liq_accounts( const double min_value, const uint64_t start_id, const uint32_t max_rows, const ReserveSnapshot& reserves, const Tables& tables = {} )
+    {
+        PIZZALEND_SCOPE( "scan_liq_accounts" );
+        check(max_rows > 0, "pizzalend: scan_liq_accounts(): max_rows must be positive");
+        const ReservePrices prices( reserves );
+        const int64_t min_liq_value = to_value( min_value );
+
+        LiqScan res { {}, start_id, false };
+        uint32_t rows = 0;
+        res.done = tables.for_each_liqdtorder( start_id, [&](const liqdtorder_row& row) {
+            if(rows++ == max_rows) {
+                res.next_id = row.id;
+                return false;
+            }
+            if(contains_code(row.collateral.quantity.symbol.code(), LIQ_EXCLUDED_CODE)) return true;
+            const int64_t liq_value = prices.get_value( row.loan );
+            if(liq_value > min_liq_value) res.orders.push_back({ row, to_double(liq_value) });
+            return true;
+        });
+
+        std::sort(res.orders.begin(), res.orders.end(), [](const LiqOrder& a, const LiqOrder& b){ return a.value > b.value; });
+        return res;
+    }
+
+    /**
+     * ## STATIC `for_each_liq_order`
+     *
+     * Call {f} with every liquidation order worth more than {min_value} and its loan value, without building a vector
+     *
+     * ### example
+     *
+     * ```c++
+     * pizzalend::for_each_liq_order( 10, reserves, [&](const liqdtorder_row& order, const double value) {
+     *     // liquidate order
+     * });
+     * ```
+     */
+    template <typename F, typename Tables = ChainTables>
+    static void for_each_liq_order( const double min_value, const ReserveSnapshot& reserves, F&& f, const Tables& tables = {} )
+    {
+        PIZZALEND_SCOPE( "for_each_liq_order" );
+        const ReservePrices prices( reserves );
+        const int64_t min_liq_value = to_value( min_value );
+        tables.for_each_liqdtorder( 0, [&](const liqdtorder_row& row) {
+            if(contains_code(row.collateral.quantity.symbol.code(), LIQ_EXCLUDED_CODE)) return true;  //disregard AIR lp tokens
+            const int64_t liq_value = prices.get_value( row.loan );
+            if(liq_value > min_liq_value) f( row, to_double(liq_value) );
+            return true;
+        });
+    }
+
+    // liquidation orders above {min_value}; the list grows with the table, use `for_each_liq_order` to avoid allocating it
+    template <typename Tables = ChainTables>
+    static vector<liqdtorder_row> get_liq_accounts( const double min_value, const ReserveSnapshot& reserves, const Tables& tables = {} ){
+        vector<liqdtorder_row> res;
+        for_each_liq_order( min_value, reserves, [&](const liqdtorder_row& row, const double) { res.push_back(row); }, tables );
+        return res;
+    }
+
     static vector<liqdtorder_row> get_liq_accounts( const double min_value ){
         //return { pizzalend::get_auction(0) };
-        liqdtorder liqdtordertbl( code, code.value );
-        vector<liqdtorder_row> res;
-        for(const auto& row: liqdtordertbl) {
-            if(row.collateral.quantity.symbol.code().to_string().find("PZUSDI") != string::npos) continue;  //disregard AIR lp tokens
-            const auto loan_res = get_reserve( row.loan.get_extended_symbol() );
-            const double loan_price = loan_res.price.amount / pow(10, loan_res.price.symbol.precision());
-            const double liq_value = row.loan.quantity.amount / pow(10, row.loan.quantity.symbol.precision()) * loan_price;
-            if(liq_value > min_value) res.push_back(row);
+        return get_liq_accounts( min_value, ReserveSnapshot{} );
+    }
+
+    static extended_asset wrap( const asset& quantity, const pztoken_row& row ) {
+        return { PzPrice::from_double( row.pzprice ).div( quantity.amount ), row.pzsymbol };
+    }
+
+    static extended_asset wrap( const asset& quantity ) {
+        PIZZALEND_SCOPE( "wrap" );
+
+        // if we know pztoken name - use primary key for speed
+        bool is_pz = false;
+        const auto key = get_pzkey(quantity.symbol.code(), &is_pz);
+        if( key && !is_pz ){
+            pztoken pztoken_tbl(code, code.value);
+            PIZZALEND_COUNT( tables, 1 );
+            PIZZALEND_COUNT( lookups, 1 );
+            PIZZALEND_COUNT( decoded, 1 );
+            const auto& row = pztoken_tbl.get( key->pzname.value, "pizzalend: not lendable");
+            return wrap( quantity, row );
         }
-        return res;
+
+        // otherwise - just iterate, decoding only the symbol of each row
+        std::optional<extended_asset> res;
+        pztoken_view::for_each([&](const pztoken_view& view) {
+            if(view.anchor_symbol() != quantity.symbol) return true;
+            res = wrap( quantity, view.row() );
+            return false;
+        });
+        check(res.has_value(), "pizzalend: not lendable: " + quantity.to_string());
+        return *res;
+    }
+
+    static extended_asset wrap( const asset& quantity, const ReserveSnapshot& reserves ) {
+        const auto row = reserves.by_anchor(quantity.symbol);
+        check(row != nullptr, "pizzalend: not lendable: " + quantity.to_string());
+        return wrap( quantity, *row );
+    }
+
+    static extended_asset unwrap( const asset& pzqty, const pztoken_row& row, bool ignore_deposit = false ) {
+        int64_t amount_out = PzPrice::from_double( row.pzprice ).mul( pzqty.amount );
+        if(amount_out > row.available_deposit.amount && !ignore_deposit) amount_out = 0;
+        return { amount_out, row.anchor };
+    }
+
+    static extended_asset unwrap( const asset& pzqty, bool ignore_deposit = false) {
+        PIZZALEND_SCOPE( "unwrap" );
+
+        // if we know pztoken name - use primary key for speed
+        bool is_pz = false;
+        const auto key = get_pzkey(pzqty.symbol.code(), &is_pz);
+        if( key && is_pz ){
+            pztoken pztoken_tbl(code, code.value);
+            PIZZALEND_COUNT( tables, 1 );
+            PIZZALEND_COUNT( lookups, 1 );
+            PIZZALEND_COUNT( decoded, 1 );
+            const auto& row = pztoken_tbl.get( key->pzname.value, "pizzalend: not redeemable");
+            return unwrap( pzqty, row, ignore_deposit );
+        }
+
+        // otherwise - just iterate, decoding only the symbol of each row
+        std::optional<extended_asset> res;
+        pztoken_view::for_each([&](const pztoken_view& view) {
+            if(view.pzsymbol_symbol() != pzqty.symbol) return true;
+            res = unwrap( pzqty, view.row(), ignore_deposit );
+            return false;
+        });
+        check(res.has_value(), "pizzalend: not redeemable: " + pzqty.to_string());
+        return *res;
+    }
+
+    static extended_asset unwrap( const asset& pzqty, const ReserveSnapshot& reserves, bool ignore_deposit = false ) {
+        const auto row = reserves.by_pzsymbol(pzqty.symbol);
+        check(row != nullptr, "pizzalend: not redeemable: " + pzqty.to_string());
+        return unwrap( pzqty, *row, ignore_deposit );
+    }
+
+    /**
+     * ## STATIC `get_amount_out`
+     *
+     * Given an input amount of an asset and pair id, returns the calculated return
+     *
+     * ### params
+     *
+     * - `{asset} in` - input amount
+     * - `{symbol} out_sym` - out symbol
+     *
+     * ### example
+     *
+     * ```c++
+     * // Inputs
+     * const asset in = asset { 10000, "USDT" };
+     * const symbol out_sym = symbol { "PZUSDT,4" };
+     *
+     * // Calculation
+     * const asset out = pizzalend::get_amount_out( in, out_sym );
+     * // => 0.999612 BUSDT
+     * ```
+     */
+    static asset get_amount_out( const asset quantity, const symbol out_sym )
+    {
+        PIZZALEND_SCOPE( "get_amount_out" );
+        if(is_pztoken(out_sym)) {
+            const auto out = wrap(quantity).quantity;
+            if(out.symbol == out_sym) return out;
+        }
+
+        if(is_pztoken(quantity.symbol)) {
+            const auto out = unwrap(quantity).quantity;
+            if(out.symbol == out_sym) return out;
+        }
+
+        check(false, "sx.pizzalend: Not pz-token");
+        return {};
+    }
+
+    static asset get_amount_out( const asset quantity, const symbol out_sym, const ReserveSnapshot& reserves )
+    {
+        if(reserves.by_pzsymbol(out_sym)) {
+            const auto out = wrap(quantity, reserves).quantity;
+            if(out.symbol == out_sym) return out;
+        }
+
+        if(reserves.by_pzsymbol(quantity.symbol)) {
+            const auto out = unwrap(quantity, reserves).quantity;
+            if(out.symbol == out_sym) return out;
+        }
+
+        check(false, "sx.pizzalend: Not pz-token");
+        return {};
+    }
+
+    struct AmountIn {
+        asset   in;             // minimal input to receive `out`, zero if it can't be received
+        asset   max_out;        // largest receivable output: `available_deposit` when unwrapping
+    };
+
+    static AmountIn get_amount_in( const asset& out, const symbol& in_sym, const pztoken_row& row )
+    {
+        const auto pzprice = PzPrice::from_double( row.pzprice );
+        if(row.anchor.get_symbol() == in_sym && row.pzsymbol.get_symbol() == out.symbol) {
+            return { { pzprice.mul_ceil( out.amount ), in_sym }, { std::numeric_limits<int64_t>::max(), out.symbol } };
+        }
+        if(row.pzsymbol.get_symbol() == in_sym && row.anchor.get_symbol() == out.symbol) {
+            // the rounded-up input can redeem more than `out`, which `unwrap` rejects if it exceeds the deposit
+            const int64_t in = pzprice.div_ceil( out.amount );
+            const bool available = pzprice.mul( in ) <= row.available_deposit.amount;
+            return { { available ? in : 0, in_sym }, row.available_deposit };
+        }
+        check(false, "sx.pizzalend: Not pz-token");
+        return {};
+    }
+
+    /**
+     * ## STATIC `get_amount_in`
+     *
+     * Given an output amount of an asset and input symbol, returns the minimal input to receive it,
+     * rounded the same way as `wrap`/`unwrap`
+     *
+     * ### params
+     *
+     * - `{asset} out` - desired output amount
+     * - `{symbol} in_sym` - in symbol
+     *
+     * ### example
+     *
+     * ```c++
+     * // Inputs
+     * const asset out = asset { 10000, "PZUSDT" };
+     * const symbol in_sym = symbol { "USDT,4" };
+     *
+     * // Calculation
+     * const auto [ in, max_out ] = pizzalend::get_amount_in( out, in_sym );
+     * // => in: "1.0500 USDT", max_out: "922337203685477.5807 PZUSDT"
+     * ```
+     */
+    static AmountIn get_amount_in( const asset out, const symbol in_sym, const ReserveSnapshot& reserves )
+    {
+        auto row = reserves.by_pzsymbol( out.symbol );
+        if(row == nullptr) row = reserves.by_pzsymbol( in_sym );
+        check(row != nullptr, "sx.pizzalend: Not pz-token");
+        return get_amount_in( out, in_sym, *row );
     }
 
-    static extended_asset wrap( const asset& quantity ) {
-
-        pztoken pztoken_tbl(code, code.value);
+    static AmountIn get_amount_in( const asset out, const symbol in_sym )
+    {
+        PIZZALEND_SCOPE( "get_amount_in" );
 
         // if we know pztoken name - use primary key for speed
-        // TODO: figure out secondary key to pull by anchor (?)
-        if( PZ_KEYS.count(quantity.symbol.code()) ){
-            const auto& row = pztoken_tbl.get( PZ_KEYS.at(quantity.symbol.code()).value, "pizzalend: not lendable");
-            return { static_cast<int64_t>( quantity.amount / row.pzprice ), row.pzsymbol };
-        }
-
-        // otherwise - just iterate
-        for(const auto& row: pztoken_tbl) {
-            if(row.anchor.get_symbol() == quantity.symbol) {
-                return { static_cast<int64_t>( quantity.amount / row.pzprice ), row.pzsymbol };
-            }
+        const auto key = get_pzkey( in_sym.code() );
+        if( key && key == get_pzkey( out.symbol.code() ) ){
+            pztoken pztoken_tbl( code, code.value );
+            PIZZALEND_COUNT( tables, 1 );
+            PIZZALEND_COUNT( lookups, 1 );
+            PIZZALEND_COUNT( decoded, 1 );
+            return get_amount_in( out, in_sym, pztoken_tbl.get( key->pzname.value, "sx.pizzalend: Not pz-token" ) );
         }
-        check(false, "pizzalend: not lendable: " + quantity.to_string());
-        return { };
+        return get_amount_in( out, in_sym, ReserveSnapshot{} );
     }
 
-    static extended_asset unwrap( const asset& pzqty, bool ignore_deposit = false) {
-        pztoken pztoken_tbl(code, code.value);
-
-        // if we know pztoken name - use primary key for speed
-        // TODO: figure out secondary key to pull by pztoken (?)
-        if( PZ_KEYS.count(pzqty.symbol.code()) ){
-            const auto& row = pztoken_tbl.get( PZ_KEYS.at(pzqty.symbol.code()).value, "pizzalend: not redeemable");
-            int64_t amount_out = row.pzprice * pzqty.amount;
-            if(amount_out > row.available_deposit.amount && !ignore_deposit) amount_out = 0;
-            return { amount_out, row.anchor };
-        }
-
-        // otherwise - just iterate
-        for(const auto& row: pztoken_tbl) {
-            if(row.pzsymbol.get_symbol() == pzqty.symbol) {
-                int64_t amount_out = row.pzprice * pzqty.amount;
-                if(amount_out > row.available_deposit.amount && !ignore_deposit) amount_out = 0;
-                return { amount_out, row.anchor };
-            }
-        }
-        check(false, "pizzalend: not redeemable: " + pzqty.to_string());
-        return { };
-    }
     /**
-     * ## STATIC `get_amount_out`
+     * ## STATIC `get_amounts_out`
      *
-     * Given an input amount of an asset and pair id, returns the calculated return
+     * Batched `get_amount_out` for many (input, out symbol) pairs resolved from a single reserves read.
+     * Pairs are classified once and quotes sharing a reserve and direction are computed together.
      *
      * ### params
      *
-     * - `{asset} in` - input amount
-     * - `{symbol} out_sym` - out symbol
+     * - `{span<const pair<asset, symbol>>} requests` - input amounts and out symbols
+     * - `{ReserveSnapshot} reserves` - reserves snapshot
      *
      * ### example
      *
      * ```c++
-     * // Inputs
-     * const asset in = asset { 10000, "USDT" };
-     * const symbol out_sym = symbol { "PZUSDT,4" };
-     *
-     * // Calculation
-     * const asset out = pizzalend::get_amount_out( in, out_sym );
-     * // => 0.999612 BUSDT
+     * const vector<pair<asset, symbol>> requests = {
+     *     { asset{ 10000, symbol{"USDT",4} }, symbol{"PZUSDT",4} },
+     *     { asset{ 10000, symbol{"PZUSN",4} }, symbol{"USN",4} }
+     * };
+     * const vector<asset> outs = pizzalend::get_amounts_out( requests, reserves );
+     * // => { "0.9524 PZUSDT", "1.0312 USN" }
      * ```
      */
-    static asset get_amount_out( const asset quantity, const symbol out_sym )
+    static vector<asset> get_amounts_out( std::span<const pair<asset, symbol>> requests, const ReserveSnapshot& reserves )
     {
-        if(is_pztoken(out_sym)) {
-            const auto out = wrap(quantity).quantity;
-            if(out.symbol == out_sym) return out;
+        struct route {
+            symbol                  in_sym;
+            symbol                  out_sym;
+            const pztoken_row*      reserve;
+            bool                    is_wrap;
+        };
+        struct quote {
+            uint32_t    route;
+            uint32_t    index;
+        };
+
+        // classify every distinct (in, out) pair once
+        vector<route> routes;
+        vector<quote> quotes;
+        quotes.reserve(requests.size());
+        for(uint32_t i = 0; i < requests.size(); ++i) {
+            const auto& [ in, out_sym ] = requests[i];
+            uint32_t r = 0;
+            while(r < routes.size() && (routes[r].in_sym != in.symbol || routes[r].out_sym != out_sym)) ++r;
+            if(r == routes.size()) {
+                const auto wrap_res = reserves.by_pzsymbol(out_sym);
+                const auto unwrap_res = reserves.by_pzsymbol(in.symbol);
+                if(wrap_res && wrap_res->anchor.get_symbol() == in.symbol) routes.push_back({ in.symbol, out_sym, wrap_res, true });
+                else if(unwrap_res && unwrap_res->anchor.get_symbol() == out_sym) routes.push_back({ in.symbol, out_sym, unwrap_res, false });
+                else check(false, "sx.pizzalend: Not pz-token");
+            }
+            quotes.push_back({ r, i });
         }
+        std::sort(quotes.begin(), quotes.end(), [](const quote& a, const quote& b){ return a.route < b.route; });
 
-        if(is_pztoken(quantity.symbol)) {
-            const auto out = unwrap(quantity).quantity;
-            if(out.symbol == out_sym) return out;
+        vector<asset> res(requests.size());
+        for(size_t begin = 0, end = 0; begin < quotes.size(); begin = end) {
+            const auto& route = routes[quotes[begin].route];
+            const auto pzprice = PzPrice::from_double( route.reserve->pzprice );
+            const int64_t available = route.reserve->available_deposit.amount;
+            for(end = begin; end < quotes.size() && quotes[end].route == quotes[begin].route; ++end) {
+                const auto i = quotes[end].index;
+                const int64_t amount = requests[i].first.amount;
+                const int64_t out = route.is_wrap ? pzprice.div( amount ) : pzprice.mul( amount );
+                res[i] = { route.is_wrap || out <= available ? out : 0, route.out_sym };
+            }
         }
+        return res;
+    }
 
-        check(false, "sx.pizzalend: Not pz-token");
-        return {};
+    static vector<asset> get_amounts_out( std::span<const pair<asset, symbol>> requests )
+    {
+        PIZZALEND_SCOPE( "get_amounts_out" );
+        return get_amounts_out( requests, ReserveSnapshot{} );
     }
 
     /**
@@ -307,24 +1325,141 @@ namespace pizzalend {
      * // => [ 1000.0, 800.0]
      * ```
      */
+    static pair<double, double> get_oraclized_value( const extended_asset& ext_tokens, const pztoken_row& row )
+    {
+        check(row.anchor == ext_tokens.get_extended_symbol(), "pizzalend: get_oraclized_value(): invalid pzname/asset combo" );
+
+        const int64_t token_value = get_value( ext_tokens.quantity, row.price );
+        const int64_t liq_value = apply_rate( token_value, row.config.liqdt_rate );
+
+        return { to_double(token_value), to_double(liq_value) };
+    }
+
     static pair<double, double> get_oraclized_value( const extended_asset ext_tokens, const name pzname )
     {
-        collateral_table _table( code, code.value);
+        PIZZALEND_SCOPE( "get_oraclized_value" );
         pztoken pztoken_tbl( code, code.value);
-        const auto row = pztoken_tbl.get(pzname.value, "pizzalend: get_oraclized_value(): invalid pzname");
-        check(row.anchor == ext_tokens.get_extended_symbol(), "pizzalend: get_oraclized_value(): invalid pzname/asset combo" );
+        PIZZALEND_COUNT( tables, 1 );
+        PIZZALEND_COUNT( lookups, 1 );
+        PIZZALEND_COUNT( decoded, 1 );
+        const auto& row = pztoken_tbl.get(pzname.value, "pizzalend: get_oraclized_value(): invalid pzname");
+        return get_oraclized_value( ext_tokens, row );
+    }
+
+    static pair<double, double> get_oraclized_value( const extended_asset ext_tokens, const name pzname, const ReserveSnapshot& reserves )
+    {
+        const auto row = reserves.by_pzname(pzname);
+        check(row != nullptr, "pizzalend: get_oraclized_value(): invalid pzname");
+        return get_oraclized_value( ext_tokens, *row );
+    }
+
+    // collateral row => unwrapped tokens and their values
+    static OraclizedAsset get_collateral( const collateral_row& row, const pztoken_row& reserve )
+    {
+        const auto ext_tokens = unwrap(row.quantity, reserve);
+        const auto [ value, ratioed_value ] = get_oraclized_value(ext_tokens, reserve);
+        return { ext_tokens, value, ratioed_value };
+    }
+
+    /**
+     * ## STATIC `get_accrued_interest`
+     *
+     * Interest accrued on a loan since its last calculation, in loan quantity units (x10000 precision)
+     *
+     * Variable rate loans (`type` 1) accrue at the reserve `floating_rate`, stable rate loans (`type` 2) at their
+     * `fixed_rate`. Interest is simple between calculations, so it is one 128-bit multiply per loan.
+     *
+     * ### params
+     *
+     * - `{loan_row} row` - loan
+     * - `{pztoken_row} reserve` - loan reserve
+     * - `{uint64_t} now` - current time in seconds since epoch
+     *
+     * ### example
+     *
+     * ```c++
+     * // 1000 USDT at 10% for half a year
+     * const int64_t interest = pizzalend::get_accrued_interest( loan, reserve, loan.last_calculated_at + SECONDS_PER_YEAR / 2 );
+     * // => 50'0000'0000 (50 USDT)
+     * ```
+     */
+    static int64_t get_accrued_interest( const loan_row& row, const pztoken_row& reserve, const uint64_t now )
+    {
+        const uint64_t since = row.last_calculated_at ? row.last_calculated_at : row.updated_at;
+        if(now <= since || row.quantity.amount <= 0) return 0;
+
+        const asset& rate = row.type == 2 ? row.fixed_rate : reserve.floating_rate;
+        if(rate.amount <= 0) return 0;
+        const uint128_t growth = static_cast<uint128_t>(rate.amount) * (now - since);
+        return to_int64( static_cast<uint128_t>(row.quantity.amount) * growth / (pow10(rate.symbol.precision()) * SECONDS_PER_YEAR) );
+    }
+
+    // loan row => owed tokens at {now} and their values
+    static OraclizedAsset get_loan( const loan_row& row, const pztoken_row& reserve, const uint64_t now )
+    {
+        // using precision x10000, so we adjust and round up
+        const int64_t owed = row.quantity.amount + get_accrued_interest( row, reserve, now );
+        const auto tokens = asset{ (owed + 9999) / 10000, row.principal.symbol };
+        const extended_asset ext_tokens = { tokens, reserve.anchor.get_contract() };
+        const auto [ value, ratioed_value ] = get_oraclized_value(ext_tokens, reserve);
+        return { ext_tokens, value, value };
+    }
 
-        const double price = row.price.amount / pow(10, row.price.symbol.precision());
-        const double token_value = ext_tokens.quantity.amount / pow(10, ext_tokens.quantity.symbol.precision()) * price;
-        const double liq_rate = row.config.liqdt_rate.amount / pow(10, row.config.liqdt_rate.symbol.precision());
+    /**
+     * ## STATIC `for_each_collateral`
+     *
+     * Given an account name call {f} with every collateral, its values and reserve, without building a vector
+     *
+     * ### example
+     *
+     * ```c++
+     * double deposited = 0;
+     * pizzalend::for_each_collateral( "myusername"_n, reserves, [&](const OraclizedAsset& coll, const pztoken_row& reserve) {
+     *     deposited += coll.ratioed;
+     * });
+     * ```
+     */
+    template <typename F, typename Tables = ChainTables>
+    static void for_each_collateral( const name account, const ReserveSnapshot& reserves, F&& f, const Tables& tables = {} )
+    {
+        PIZZALEND_SCOPE( "for_each_collateral" );
+        tables.for_each_collateral( account, [&](const collateral_row& row) {
+            const auto reserve = reserves.by_pzname(row.pzname);
+            check(reserve != nullptr, "pizzalend: for_each_collateral(): unknown collateral reserve");
+            f( get_collateral(row, *reserve), *reserve );
+        });
+    }
 
-        return { token_value, token_value * liq_rate };
+    /**
+     * ## STATIC `for_each_loan`
+     *
+     * Given an account name call {f} with every loan (with interest projected to now), its value and reserve
+     *
+     * ### example
+     *
+     * ```c++
+     * double loaned = 0;
+     * pizzalend::for_each_loan( "myusername"_n, reserves, [&](const OraclizedAsset& loan, const pztoken_row& reserve) {
+     *     loaned += loan.value;
+     * });
+     * ```
+     */
+    template <typename F, typename Tables = ChainTables>
+    static void for_each_loan( const name account, const ReserveSnapshot& reserves, F&& f, const Tables& tables = {} )
+    {
+        PIZZALEND_SCOPE( "for_each_loan" );
+        const uint64_t now = tables.now();
+        tables.for_each_loan( account, [&](const loan_row& row) {
+            const auto reserve = reserves.by_pzname(row.pzname);
+            check(reserve != nullptr, "pizzalend: for_each_loan(): unknown loan reserve");
+            f( get_loan(row, *reserve, now), *reserve );
+        });
     }
 
     /**
      * ## STATIC `get_collaterals`
      *
-     * Given an account name return collaterals and their values
+     * Given an account name return collaterals and their values, stored inline up to `MAX_POSITIONS` entries
      *
      * ### params
      *
@@ -337,32 +1472,31 @@ namespace pizzalend {
      * const name account = "myusername";
      *
      * // Calculation
-     * const vector<StOraclizedAsset> collaterals = pizzalend::get_collaterals( account );
+     * const auto collaterals = pizzalend::get_collaterals( account );
      * // => { {"400 USDT", 400, 300}, {"100 EOS", 500, 375} }
      * ```
      */
-    static vector<OraclizedAsset> get_collaterals( const name account )
+    template <typename Tables = ChainTables>
+    static SmallVector<OraclizedAsset, MAX_POSITIONS> get_collaterals( const name account, const ReserveSnapshot& reserves, const Tables& tables = {} )
     {
-        vector<OraclizedAsset> res;
-        collateral_table _table( code, code.value);
-        auto index = _table.get_index<"byaccount"_n>();
-        auto it = index.lower_bound(account.value);
-        while( it != index.end() ) {
-            if( it->account != account) break;
-            const auto pztokens = it->quantity;
-            const auto ext_tokens = unwrap(pztokens);
-            const auto [ value, ratioed_value ] = get_oraclized_value(ext_tokens, it->pzname);
-            res.push_back({ ext_tokens, value, ratioed_value });
-            ++it;
-        }
+        PIZZALEND_SCOPE( "get_collaterals" );
+        SmallVector<OraclizedAsset, MAX_POSITIONS> res;
+        for_each_collateral( account, reserves, [&](const OraclizedAsset& coll, const pztoken_row&) {
+            res.push_back( coll );
+        }, tables );
 
         return res;
     }
 
+    static SmallVector<OraclizedAsset, MAX_POSITIONS> get_collaterals( const name account )
+    {
+        return get_collaterals( account, ReserveSnapshot{} );
+    }
+
         /**
      * ## STATIC `get_loans`
      *
-     * Given an account name return loans and their values
+     * Given an account name return loans and their values, stored inline up to `MAX_POSITIONS` entries
      *
      * ### params
      *
@@ -375,31 +1509,27 @@ namespace pizzalend {
      * const name account = "myusername";
      *
      * // Calculation
-     * const vector<StOraclizedAsset> collaterals = pizzalend::get_loans( account );
+     * const auto loans = pizzalend::get_loans( account );
      * // => { {"400 USDT", 400, 300}, {"100 EOS", 500, 375} }
      * ```
      */
-    static vector<OraclizedAsset> get_loans( const name account )
-    {
-        vector<OraclizedAsset> res;
-        loan_table _table( code, code.value);
-        auto index = _table.get_index<"byaccount"_n>();
-        auto it = index.lower_bound(account.value);
-        while( it != index.end() ) {
-            if( it->account != account) break;
-            // TODO: take interest accrued since last update into account
-            // using precision x10000, so we adjust and round up
-            const auto tokens = asset{ it->quantity.amount / 10000 + 1, it->principal.symbol };
-            const auto ext_sym = get_anchor(it->pzname);
-            const extended_asset ext_tokens = { tokens, ext_sym.get_contract() };
-            const auto [ value, ratioed_value ] = get_oraclized_value(ext_tokens, it->pzname);
-            res.push_back({ ext_tokens, value, value });
-            ++it;
-        }
+    template <typename Tables = ChainTables>
+    static SmallVector<OraclizedAsset, MAX_POSITIONS> get_loans( const name account, const ReserveSnapshot& reserves, const Tables& tables = {} )
+    {
+        PIZZALEND_SCOPE( "get_loans" );
+        SmallVector<OraclizedAsset, MAX_POSITIONS> res;
+        for_each_loan( account, reserves, [&](const OraclizedAsset& loan, const pztoken_row&) {
+            res.push_back( loan );
+        }, tables );
 
         return res;
     }
 
+    static SmallVector<OraclizedAsset, MAX_POSITIONS> get_loans( const name account )
+    {
+        return get_loans( account, ReserveSnapshot{} );
+    }
+
     /**
      * ## STATIC `get_health_factor`
      *
@@ -407,8 +1537,8 @@ namespace pizzalend {
      *
      * ### params
      *
-     * - `{vector<OraclizedAsset>} loans` - loans
-     * - `{vector<OraclizedAsset>} collaterals` - collaterals
+     * - `{span<const OraclizedAsset>} loans` - loans
+     * - `{span<const OraclizedAsset>} collaterals` - collaterals
      *
      * ### example
      *
@@ -422,14 +1552,14 @@ namespace pizzalend {
      * // => 1.2345
      * ```
      */
-    static double get_health_factor( const vector<OraclizedAsset>& loans, const vector<OraclizedAsset>& collaterals )
+    static double get_health_factor( std::span<const OraclizedAsset> loans, std::span<const OraclizedAsset> collaterals )
     {
         double deposited = 0, loaned = 0;
-        for(const auto coll: collaterals){
+        for(const auto& coll: collaterals){
             deposited += coll.ratioed;
         }
 
-        for(const auto loan: loans){
+        for(const auto& loan: loans){
             loaned += loan.value;
         }
         return loaned == 0 ? 0 : deposited / loaned;
@@ -441,9 +1571,14 @@ namespace pizzalend {
      *
      * Given an account name return user health factor
      *
+     * Positions are summed through `for_each_collateral`/`for_each_loan` without building containers. Without
+     * {reserves} the `pztoken` table is first loaded into a `ReserveSnapshot`, which allocates its rows: pass a
+     * snapshot reused across calls to avoid it. On chain `multi_index` still allocates its own row cache.
+     *
      * ### params
      *
      * - `{name} account` - account
+     * - `{ReserveSnapshot} reserves` - (optional) reserves snapshot
      *
      * ### example
      *
@@ -456,12 +1591,42 @@ namespace pizzalend {
      * // => 1.2345
      * ```
      */
+    template <typename Tables = ChainTables>
+    static double get_health_factor( const name account, const ReserveSnapshot& reserves, const Tables& tables = {} )
+    {
+        PIZZALEND_SCOPE( "get_health_factor" );
+        double deposited = 0, loaned = 0;
+        for_each_collateral( account, reserves, [&](const OraclizedAsset& coll, const pztoken_row&) { deposited += coll.ratioed; }, tables );
+        for_each_loan( account, reserves, [&](const OraclizedAsset& loan, const pztoken_row&) { loaned += loan.value; }, tables );
+
+        return loaned == 0 ? 0 : deposited / loaned;
+    }
+
     static double get_health_factor( const name account )
     {
-        const auto collaterals = pizzalend::get_collaterals(account);
-        const auto loans = pizzalend::get_loans(account);
+        return pizzalend::get_health_factor( account, ReserveSnapshot{} );
+    }
+
+    // collateral amount for liquidating {in} debt, before capping by collateral held
+    static int64_t get_liquidation_amount( const asset& in, const pztoken_row& loan_res, const pztoken_row& coll_res )
+    {
+        const auto& bonus = coll_res.config.liqdt_bonus;
+        const int64_t liq_value = get_value( in, loan_res.price );
+        const int64_t value_out = liq_value + mul_div( liq_value, 2 * bonus.amount, 3 * pow10(bonus.symbol.precision()) );     // receiving 2/3 of the bonus
+        return get_amount( value_out, coll_res.price, coll_res.anchor.get_symbol() );
+    }
+
+    // liquidation math once loan/collateral positions and their reserves are resolved
+    static extended_asset get_liquidation_out( const extended_asset& ext_in, const extended_asset& coll_to_get, const double loans_value, const pztoken_row& loan_res, const pztoken_row& coll_res )
+    {
+        const extended_symbol ext_sym_out = coll_to_get.get_extended_symbol();
+        const int64_t liq_value = get_value( ext_in.quantity, loan_res.price );
+        const int64_t out = get_liquidation_amount( ext_in.quantity, loan_res, coll_res );
+
+        if(to_double(liq_value) > loans_value || coll_to_get.quantity.amount < out)
+            return { coll_to_get.quantity.amount, ext_sym_out };   //can't get more than collateral
 
-        return pizzalend::get_health_factor(loans, collaterals);
+        return { out, ext_sym_out };
     }
 
     /**
@@ -473,8 +1638,8 @@ namespace pizzalend {
      *
      * - `{extended_asset} ext_in` - amount of debt to liquidate
      * - `{extended_symbol} ext_sym_out` - desired collateral to receive
-     * - `{vector<OraclizedAsset>} loans` - user loans
-     * - `{vector<OraclizedAsset>} collaterals` - user collaterals
+     * - `{span<const OraclizedAsset>} loans` - user loans
+     * - `{span<const OraclizedAsset>} collaterals` - user collaterals
      *
      * ### example
      *
@@ -490,7 +1655,7 @@ namespace pizzalend {
      * // => 100 EOS
      * ```
      */
-    static extended_asset get_liquidation_out( const extended_asset ext_in, const extended_symbol ext_sym_out, const vector<OraclizedAsset>& loans, const vector<OraclizedAsset>& collaterals )
+    static extended_asset get_liquidation_out( const extended_asset ext_in, const extended_symbol ext_sym_out, std::span<const OraclizedAsset> loans, std::span<const OraclizedAsset> collaterals, const ReserveSnapshot& reserves )
     {
         // no need to check health factor - if we are in the table then it's < 1
         // const auto hf = get_health_factor(loans, collaterals);
@@ -498,30 +1663,438 @@ namespace pizzalend {
 
         double loans_value = 0;
         extended_asset loan_to_liquidate, coll_to_get;
-        for(const auto loan: loans){
+        for(const auto& loan: loans){
             if(loan.tokens.get_extended_symbol() == ext_in.get_extended_symbol() ) loan_to_liquidate = loan.tokens;
             loans_value += loan.value;
         }
-        for(const auto coll: collaterals){
+        for(const auto& coll: collaterals){
             if(coll.tokens.get_extended_symbol() == ext_sym_out ) coll_to_get = coll.tokens;
         }
 
         if(loan_to_liquidate.quantity.amount == 0 || loan_to_liquidate < ext_in || coll_to_get.quantity.amount == 0)
             return { 0, ext_sym_out };
 
-        const auto loan_res = get_reserve( ext_in.get_extended_symbol() );
-        const auto coll_res = get_reserve( ext_sym_out );
-        const double bonus = coll_res.config.liqdt_bonus.amount / pow(10, coll_res.config.liqdt_bonus.symbol.precision());
-        const double loan_price = loan_res.price.amount / pow(10, loan_res.price.symbol.precision());
-        const double coll_price = coll_res.price.amount / pow(10, coll_res.price.symbol.precision());
-        const double liq_value = ext_in.quantity.amount / pow(10, ext_in.quantity.symbol.precision()) * loan_price;
-        const double value_out = liq_value * (1 + bonus * 2/3);     // receiving 2/3 of the bonus
-        const int64_t out = value_out / coll_price * pow(10, coll_res.anchor.get_symbol().precision());
+        const auto& loan_res = get_reserve( ext_in.get_extended_symbol(), reserves );
+        const auto& coll_res = get_reserve( ext_sym_out, reserves );
+        return get_liquidation_out( ext_in, coll_to_get, loans_value, loan_res, coll_res );
+    }
 
-        if(liq_value > loans_value || coll_to_get.quantity.amount < out)
-            return { coll_to_get.quantity.amount, ext_sym_out };   //can't get more than collateral
+    static extended_asset get_liquidation_out( const extended_asset ext_in, const extended_symbol ext_sym_out, std::span<const OraclizedAsset> loans, std::span<const OraclizedAsset> collaterals )
+    {
+        PIZZALEND_SCOPE( "get_liquidation_out" );
+        return get_liquidation_out( ext_in, ext_sym_out, loans, collaterals, ReserveSnapshot{} );
+    }
 
-        return { out, ext_sym_out };
+    /**
+     * ## STRUCT `AccountPosition`
+     *
+     * Account collaterals and loans priced in one sweep of `collateral` and `loan` against a reserves snapshot.
+     * Totals, health factor and liquidation quotes are then computed without further table reads.
+     *
+     * ### example
+     *
+     * ```c++
+     * const pizzalend::ReserveSnapshot reserves;
+     * const pizzalend::AccountPosition position( "myusername"_n, reserves );
+     *
+     * const double health_factor = position.health_factor();
+     * // => 0.9512
+     * const auto out = position.get_liquidation_out( { "400.0000 USDT", "tethertether"_n }, { symbol{"EOS", 4}, "eosio.token"_n } );
+     * // => 100 EOS
+     * ```
+     */
+    struct AccountPosition {
+        name                        account;
+        SmallVector<OraclizedAsset, MAX_POSITIONS>      collaterals;
+        SmallVector<OraclizedAsset, MAX_POSITIONS>      loans;
+        SmallVector<const pztoken_row*, MAX_POSITIONS>  collateral_reserves;    // same order as collaterals
+        SmallVector<const pztoken_row*, MAX_POSITIONS>  loan_reserves;          // same order as loans
+        double                      collateral_value = 0;
+        double                      ratioed_value = 0;
+        double                      loan_value = 0;
+
+        template <typename Tables = ChainTables>
+        AccountPosition( const name account, const ReserveSnapshot& reserves, const Tables& tables = {} ): account( account ) {
+            PIZZALEND_SCOPE( "AccountPosition" );
+            tables.for_each_collateral( account, [&](const collateral_row& row){ add_collateral(row, reserves); });
+            const uint64_t now = tables.now();
+            tables.for_each_loan( account, [&](const loan_row& row){ add_loan(row, reserves, now); });
+        }
+
+        double health_factor() const {
+            return loan_value == 0 ? 0 : ratioed_value / loan_value;
+        }
+
+        extended_asset get_liquidation_out( const extended_asset& ext_in, const extended_symbol& ext_sym_out ) const {
+            int loan_i = -1, coll_i = -1;
+            for(size_t i = 0; i < loans.size(); ++i)
+                if(loans[i].tokens.get_extended_symbol() == ext_in.get_extended_symbol()) loan_i = i;
+            for(size_t i = 0; i < collaterals.size(); ++i)
+                if(collaterals[i].tokens.get_extended_symbol() == ext_sym_out) coll_i = i;
+
+            if(loan_i < 0 || coll_i < 0) return { 0, ext_sym_out };
+            const auto& loan_to_liquidate = loans[loan_i].tokens;
+            const auto& coll_to_get = collaterals[coll_i].tokens;
+            if(loan_to_liquidate.quantity.amount == 0 || loan_to_liquidate < ext_in || coll_to_get.quantity.amount == 0)
+                return { 0, ext_sym_out };
+
+            return pizzalend::get_liquidation_out( ext_in, coll_to_get, loan_value, *loan_reserves[loan_i], *collateral_reserves[coll_i] );
+        }
+
+    private:
+        void add_collateral( const collateral_row& row, const ReserveSnapshot& reserves ) {
+            const auto reserve = reserves.by_pzname(row.pzname);
+            check(reserve != nullptr, "pizzalend: AccountPosition: unknown collateral reserve");
+            collaterals.push_back( pizzalend::get_collateral(row, *reserve) );
+            collateral_reserves.push_back( reserve );
+            collateral_value += collaterals.back().value;
+            ratioed_value += collaterals.back().ratioed;
+        }
+
+        void add_loan( const loan_row& row, const ReserveSnapshot& reserves, const uint64_t now ) {
+            const auto reserve = reserves.by_pzname(row.pzname);
+            check(reserve != nullptr, "pizzalend: AccountPosition: unknown loan reserve");
+            loans.push_back( pizzalend::get_loan(row, *reserve, now) );
+            loan_reserves.push_back( reserve );
+            loan_value += loans.back().value;
+        }
+    };
+
+    struct HealthCheck {
+        double      factor;
+        bool        cached;         // true if taken from `cachedhealth`, false if recomputed
+    };
+
+    /**
+     * ## STATIC `get_health_factor`
+     *
+     * Given an account name return health factor from `cachedhealth` if it is recent enough, otherwise recompute it
+     *
+     * The cached row is accepted when it is at most {max_age} seconds old and none of the reserves {pznames} was
+     * updated after it. Only the caller knows which reserves the account uses without reading its collateral and
+     * loan rows, which is what the cache saves: when {pznames} is empty every reserve is checked, so a price update
+     * on any reserve falls back to a full recompute. Listing fewer reserves than the account uses returns a stale factor.
+     * Without a block time (`now()` is 0) or with a clock behind the cached row, the row is never accepted.
+     *
+     * ### params
+     *
+     * - `{name} account` - account
+     * - `{uint64_t} max_age` - maximum age of cached health factor in seconds
+     * - `{ReserveSnapshot} reserves` - reserves snapshot
+     * - `{span<name>} pznames` - (optional) reserves the account deposits in or borrows from
+     *
+     * ### example
+     *
+     * ```c++
+     * const auto [ factor, cached ] = pizzalend::get_health_factor( "myusername"_n, 60, reserves, vector<name>{ "pzeos"_n, "pzusdt"_n } );
+     * // => { 1.2345, true }
+     * ```
+     */
+    template <typename Tables = ChainTables>
+    static HealthCheck get_health_factor( const name account, const uint64_t max_age, const ReserveSnapshot& reserves, std::span<const name> pznames = {}, const Tables& tables = {} )
+    {
+        PIZZALEND_SCOPE( "get_health_factor" );
+        if(const auto cached = tables.get_cachedhealth( account )) {
+            const uint64_t cached_at = cached->updated_at;
+            const uint64_t now = tables.now();
+            const bool fresh = now != 0 && now >= cached_at && now - cached_at <= max_age;
+            if(fresh && reserves.get_updated_at( pznames ) <= cached_at) return { cached->factor, true };
+        }
+        return { AccountPosition( account, reserves, tables ).health_factor(), false };
+    }
+
+    // largest amount in [0, limit] satisfying monotone {fits}, searching outward from {guess}
+    template <typename F>
+    static int64_t get_max_fitting( const int64_t guess, const int64_t limit, F&& fits )
+    {
+        int64_t lo, hi;                 // fits(lo) (or lo == 0), !fits(hi) (or hi == limit + 1)
+        if(fits(guess)) {
+            lo = guess;
+            for(int64_t step = 1; ; step *= 2) {
+                hi = lo + step > limit ? limit + 1 : lo + step;
+                if(hi > limit || !fits(hi)) break;
+                lo = hi;
+            }
+        } else {
+            hi = guess;
+            for(int64_t step = 1; ; step *= 2) {
+                lo = hi - step < 0 ? 0 : hi - step;
+                if(lo == 0 || fits(lo)) break;
+                hi = lo;
+            }
+            if(lo == 0 && !fits(0)) return 0;
+        }
+        while(hi - lo > 1) {
+            const int64_t mid = lo + (hi - lo) / 2;
+            if(fits(mid)) lo = mid;
+            else hi = mid;
+        }
+        return lo;
+    }
+
+    struct LiquidationPlan {
+        extended_asset  in;             // debt to repay, zero if nothing to liquidate
+        extended_asset  out;            // collateral to receive
+        double          profit;         // value of {out} minus value of {in}
+    };
+
+    /**
+     * ## STATIC `get_best_liquidation`
+     *
+     * Given account loans and collaterals return the most profitable liquidation (loan, collateral, amount)
+     *
+     * Profit grows linearly with repaid debt (2/3 of `liqdt_bonus`) until the received collateral reaches the collateral
+     * held, so the optimum of every pair is at that boundary or at the full loan amount, whichever comes first.
+     * With {respect_order} only the loans and collaterals with the lowest `borrow_liqdt_order`/`collateral_liqdt_order`
+     * held by the account are considered, following the order in which `lend.pizza` liquidates positions.
+     * The result is within the value of one smallest debt unit of the exact optimum (rounding of received collateral).
+     *
+     * ### params
+     *
+     * - `{span<const OraclizedAsset>} loans` - user loans
+     * - `{span<const OraclizedAsset>} collaterals` - user collaterals
+     * - `{ReserveSnapshot} reserves` - reserves snapshot
+     * - `{bool} respect_order` - only consider positions first in liquidation order (default true)
+     *
+     * ### example
+     *
+     * ```c++
+     * const pizzalend::AccountPosition position( "liquidateme"_n, reserves );
+     * const auto plan = pizzalend::get_best_liquidation( position );
+     * // => { in: "290.0001 USDT@tethertether", out: "8.5381 EOS@eosio.token", profit: 8.69 }
+     * ```
+     */
+    static LiquidationPlan get_best_liquidation( std::span<const OraclizedAsset> loans, std::span<const pztoken_row* const> loan_reserves,
+                                                 std::span<const OraclizedAsset> collaterals, std::span<const pztoken_row* const> collateral_reserves,
+                                                 const bool respect_order = true )
+    {
+        double loans_value = 0;
+        uint8_t loan_order = std::numeric_limits<uint8_t>::max(), coll_order = std::numeric_limits<uint8_t>::max();
+        for(size_t i = 0; i < loans.size(); ++i) {
+            loans_value += loans[i].value;
+            if(loans[i].tokens.quantity.amount > 0) loan_order = std::min(loan_order, loan_reserves[i]->config.borrow_liqdt_order);
+        }
+        for(size_t j = 0; j < collaterals.size(); ++j) {
+            if(collaterals[j].tokens.quantity.amount > 0) coll_order = std::min(coll_order, collateral_reserves[j]->config.collateral_liqdt_order);
+        }
+
+        LiquidationPlan best { {}, {}, 0 };
+        int64_t best_profit = 0;
+        for(size_t i = 0; i < loans.size(); ++i) {
+            const auto& loan = loans[i].tokens;
+            const auto& loan_res = *loan_reserves[i];
+            if(loan.quantity.amount == 0 || (respect_order && loan_res.config.borrow_liqdt_order != loan_order)) continue;
+
+            for(size_t j = 0; j < collaterals.size(); ++j) {
+                const auto& coll = collaterals[j].tokens;
+                const auto& coll_res = *collateral_reserves[j];
+                if(coll.quantity.amount == 0 || (respect_order && coll_res.config.collateral_liqdt_order != coll_order)) continue;
+
+                // largest debt whose value plus 2/3 of the bonus still fits in the collateral
+                const auto& bonus = coll_res.config.liqdt_bonus;
+                const uint128_t bonus_denom = 3 * pow10(bonus.symbol.precision());
+                const int64_t coll_value = get_value( coll.quantity, coll_res.price );
+                const int64_t max_in_value = to_int64( static_cast<uint128_t>(coll_value) * bonus_denom / (bonus_denom + 2 * bonus.amount) );
+                const int64_t max_in = get_amount( max_in_value, loan_res.price, loan.quantity.symbol );
+
+                // closed form is exact up to rounding of fixed-point values - settle the boundary around it
+                const auto get_out = [&](const int64_t amount) {
+                    return get_liquidation_amount( asset{ amount, loan.quantity.symbol }, loan_res, coll_res );
+                };
+                const auto consider = [&](const int64_t amount) {
+                    const extended_asset in { amount, loan.get_extended_symbol() };
+                    const auto out = get_liquidation_out( in, coll, loans_value, loan_res, coll_res );
+                    const int64_t profit = get_value( out.quantity, coll_res.price ) - get_value( in.quantity, loan_res.price );
+                    if(profit > best_profit) {
+                        best_profit = profit;
+                        best = { in, out, to_double(profit) };
+                    }
+                };
+                const int64_t fit_in = get_max_fitting( std::min(max_in, loan.quantity.amount), loan.quantity.amount,
+                                                        [&](const int64_t amount){ return get_out(amount) <= coll.quantity.amount; } );
+
+                // collateral is rounded down, so the cheapest debt reaching the same collateral amount is more profitable
+                const int64_t target = fit_in > 0 ? get_out(fit_in) : 0;
+                if(target > 0) consider( get_max_fitting( fit_in, fit_in, [&](const int64_t amount){ return get_out(amount) < target; } ) + 1 );
+
+                // one unit more is capped at the whole collateral
+                if(fit_in < loan.quantity.amount) consider( fit_in + 1 );
+            }
+        }
+        return best;
+    }
+
+    static LiquidationPlan get_best_liquidation( std::span<const OraclizedAsset> loans, std::span<const OraclizedAsset> collaterals, const ReserveSnapshot& reserves, const bool respect_order = true )
+    {
+        SmallVector<const pztoken_row*, MAX_POSITIONS> loan_reserves, collateral_reserves;
+        for(const auto& loan: loans) loan_reserves.push_back( &get_reserve( loan.tokens.get_extended_symbol(), reserves ) );
+        for(const auto& coll: collaterals) collateral_reserves.push_back( &get_reserve( coll.tokens.get_extended_symbol(), reserves ) );
+
+        return get_best_liquidation( loans, loan_reserves, collaterals, collateral_reserves, respect_order );
+    }
+
+    static LiquidationPlan get_best_liquidation( const AccountPosition& position, const bool respect_order = true )
+    {
+        return get_best_liquidation( position.loans, position.loan_reserves, position.collaterals, position.collateral_reserves, respect_order );
     }
 
-}
\ No newline at end of file
+    /**
+     * ## STRUCT `PositionSimulator`
+     *
+     * What-if copy of an `AccountPosition`: deposits, withdrawals, borrows, repays and liquidations update
+     * per-reserve amounts and running value sums in place (exact fixed-point deltas, no table reads),
+     * so each query after a delta is constant time. Copy it to try candidate actions from the same state.
+     *
+     * Borrow limit is collateral value weighted by `max_ltv`, health factor uses collateral weighted by `liqdt_rate`.
+     *
+     * ### example
+     *
+     * ```c++
+     * const pizzalend::AccountPosition position( "myusername"_n, reserves );
+     * pizzalend::PositionSimulator sim( position, reserves );
+     *
+     * sim.deposit( { asset{ 1000000, symbol{"EOS",4} }, "eosio.token"_n } );
+     * sim.borrow( { asset{ 500000, symbol{"USDT",4} }, "tethertether"_n } );
+     * const double health_factor = sim.health_factor();
+     * // => 1.4
+     * const asset max_borrow = sim.get_max_borrow( { symbol{"USDT",4}, "tethertether"_n } );
+     * // => "120.5000 USDT"
+     * ```
+     */
+    struct PositionSimulator {
+        PositionSimulator( const AccountPosition& position, const ReserveSnapshot& reserves ): reserves( &reserves ) {
+            for(size_t i = 0; i < position.collaterals.size(); ++i)
+                update( get_holding( position.collateral_reserves[i]->pztoken ), position.collaterals[i].tokens.quantity.amount, 0 );
+            for(size_t i = 0; i < position.loans.size(); ++i)
+                update( get_holding( position.loan_reserves[i]->pztoken ), 0, position.loans[i].tokens.quantity.amount );
+        }
+
+        void deposit( const extended_asset& tokens ) {
+            update( get_holding( tokens ), tokens.quantity.amount, 0 );
+        }
+
+        void withdraw( const extended_asset& tokens ) {
+            auto& holding = get_holding( tokens );
+            check( tokens.quantity.amount <= holding.collateral, "pizzalend: PositionSimulator: withdraw exceeds collateral" );
+            update( holding, -tokens.quantity.amount, 0 );
+        }
+
+        void borrow( const extended_asset& tokens ) {
+            update( get_holding( tokens ), 0, tokens.quantity.amount );
+        }
+
+        // repaying more than owed repays the whole loan
+        void repay( const extended_asset& tokens ) {
+            auto& holding = get_holding( tokens );
+            update( holding, 0, -std::min( tokens.quantity.amount, holding.loan ) );
+        }
+
+        // liquidate {ext_in} debt for {ext_sym_out} collateral, same rules as `get_liquidation_out`, returns collateral received
+        extended_asset liquidate( const extended_asset& ext_in, const extended_symbol& ext_sym_out ) {
+            const auto loan = find_holding( &get_reserve( ext_in.get_extended_symbol() ) );
+            const auto coll = find_holding( &get_reserve( ext_sym_out ) );
+            if(!loan || !coll || loan->loan == 0 || loan->loan < ext_in.quantity.amount || coll->collateral == 0) return { 0, ext_sym_out };
+
+            const extended_asset coll_to_get = { coll->collateral, ext_sym_out };
+            const auto out = pizzalend::get_liquidation_out( ext_in, coll_to_get, to_double(loan_value), *loan->reserve, *coll->reserve );
+            update( *loan, 0, -ext_in.quantity.amount );
+            update( *coll, -out.quantity.amount, 0 );
+            return out;
+        }
+
+        double health_factor() const {
+            return loan_value == 0 ? 0 : double(ratioed_value) / loan_value;
+        }
+
+        double get_collateral_value() const { return to_double(collateral_value); }
+        double get_loan_value() const { return to_double(loan_value); }
+        double get_borrow_limit() const { return to_double(borrow_limit); }
+
+        // largest borrow keeping loans within the borrow limit, capped by reserve liquidity
+        asset get_max_borrow( const extended_symbol& ext_sym ) const {
+            const auto& reserve = get_reserve( ext_sym );
+            const int64_t headroom = std::max<int64_t>( borrow_limit - loan_value, 0 );
+            const int64_t amount = get_amount( headroom, reserve.price, ext_sym.get_symbol() );
+            return { std::min( amount, reserve.available_deposit.amount ), ext_sym.get_symbol() };
+        }
+
+        // largest withdrawal keeping loans within the borrow limit, capped by collateral held and reserve liquidity
+        asset get_max_withdraw( const extended_symbol& ext_sym ) const {
+            const auto& reserve = get_reserve( ext_sym );
+            int64_t amount = 0;
+            for(const auto& holding: holdings)
+                if(holding.reserve == &reserve) amount = holding.collateral;
+
+            const auto& max_ltv = reserve.config.max_ltv;
+            if(loan_value > 0 && max_ltv.amount > 0) {
+                const int64_t headroom = std::max<int64_t>( borrow_limit - loan_value, 0 );
+                const int64_t value = mul_div( headroom, pow10(max_ltv.symbol.precision()), max_ltv.amount );
+                amount = std::min( amount, get_amount( value, reserve.price, ext_sym.get_symbol() ) );
+            }
+            return { std::min( amount, reserve.available_deposit.amount ), ext_sym.get_symbol() };
+        }
+
+    private:
+        struct holding {
+            const pztoken_row*  reserve;
+            int64_t             collateral = 0;     // anchor tokens
+            int64_t             loan = 0;           // anchor tokens
+        };
+
+        const ReserveSnapshot*              reserves;
+        SmallVector<holding, MAX_POSITIONS> holdings;
+        int64_t                             collateral_value = 0;
+        int64_t                             ratioed_value = 0;      // weighted by `liqdt_rate`
+        int64_t                             borrow_limit = 0;       // weighted by `max_ltv`
+        int64_t                             loan_value = 0;
+
+        const pztoken_row& get_reserve( const extended_symbol& ext_sym ) const {
+            return pizzalend::get_reserve( ext_sym, *reserves );
+        }
+
+        holding* find_holding( const pztoken_row* reserve ) {
+            for(auto& holding: holdings)
+                if(holding.reserve == reserve) return &holding;
+            return nullptr;
+        }
+
+        holding& get_holding( const pztoken_row* reserve ) {
+            if(const auto holding = find_holding( reserve )) return *holding;
+            holdings.push_back({ reserve });
+            return holdings.back();
+        }
+
+        // {position} may be built on another snapshot of the same tables, holdings point into {reserves}
+        holding& get_holding( const name pzname ) {
+            const auto reserve = reserves->by_pzname( pzname );
+            check( reserve != nullptr, "pizzalend: PositionSimulator: unknown reserve" );
+            return get_holding( reserve );
+        }
+
+        holding& get_holding( const extended_asset& tokens ) {
+            return get_holding( &get_reserve( tokens.get_extended_symbol() ) );
+        }
+
+        holding& get_holding( const extended_symbol& ext_sym ) {
+            return get_holding( &get_reserve( ext_sym ) );
+        }
+
+        // replace holding contribution to the running sums
+        void update( holding& holding, const int64_t collateral_delta, const int64_t loan_delta ) {
+            add( holding, -1 );
+            holding.collateral += collateral_delta;
+            holding.loan += loan_delta;
+            add( holding, 1 );
+        }
+
+        void add( const holding& holding, const int64_t sign ) {
+            const auto& reserve = *holding.reserve;
+            const symbol sym = reserve.anchor.get_symbol();
+            const int64_t value = get_value( { holding.collateral, sym }, reserve.price );
+            collateral_value += sign * value;
+            ratioed_value += sign * apply_rate( value, reserve.config.liqdt_rate );
+            borrow_limit += sign * apply_rate( value, reserve.config.max_ltv );
+            loan_value += sign * get_value( { holding.loan, sym }, reserve.price );
+        }
+    };
+}
@@ -0,0 +1,272 @@
+#pragma once
+
+#include <chrono>
+#include <istream>
+#include <ostream>
+#include <type_traits>
+#include <unordered_map>
+
+#include "snapshot.hpp"
+
+// Deterministic replay of `lend.pizza` table history through the library, for backtesting bots (not for WASM contracts)
+namespace pizzalend {
+
+    enum replay_table : uint8_t {
+        REPLAY_PZTOKEN,
+        REPLAY_COLLATERAL,
+        REPLAY_LOAN,
+        REPLAY_LIQDTORDER,
+        REPLAY_CACHEDHEALTH
+    };
+
+    constexpr char REPLAY_MAGIC[8] = { 'P', 'Z', 'R', 'E', 'P', 'L', 'A', 'Y' };
+    constexpr uint32_t REPLAY_VERSION = 1;
+
+    // start of a replay stream, rows are stored as raw structs like in snapshots
+    struct replay_header {
+        char        magic[8];
+        uint32_t    version;
+        uint32_t    byte_order;     // SNAPSHOT_BYTE_ORDER as written
+        uint64_t    layout;         // SNAPSHOT_LAYOUT of the writer
+    };
+
+    // replay stream record, followed by `size` bytes of the row
+    struct replay_event {
+        uint64_t    time;           // block time in seconds since epoch, non-decreasing
+        uint8_t     table;          // replay_table
+        uint8_t     erase;          // 1 = row removed, 0 = row inserted or modified
+        uint16_t    reserved;
+        uint32_t    size;           // sizeof row
+    };
+
+    template <typename T> constexpr replay_table get_replay_table();
+    template <> constexpr replay_table get_replay_table<pztoken_row>() { return REPLAY_PZTOKEN; }
+    template <> constexpr replay_table get_replay_table<collateral_row>() { return REPLAY_COLLATERAL; }
+    template <> constexpr replay_table get_replay_table<loan_row>() { return REPLAY_LOAN; }
+    template <> constexpr replay_table get_replay_table<liqdtorder_row>() { return REPLAY_LIQDTORDER; }
+    template <> constexpr replay_table get_replay_table<cachedhealth_row>() { return REPLAY_CACHEDHEALTH; }
+
+    // sizeof the row of {table}, 0 if unknown
+    static constexpr uint32_t get_replay_row_size( const uint8_t table ) {
+        switch(table) {
+            case REPLAY_PZTOKEN: return sizeof(pztoken_row);
+            case REPLAY_COLLATERAL: return sizeof(collateral_row);
+            case REPLAY_LOAN: return sizeof(loan_row);
+            case REPLAY_LIQDTORDER: return sizeof(liqdtorder_row);
+            case REPLAY_CACHEDHEALTH: return sizeof(cachedhealth_row);
+        }
+        return 0;
+    }
+
+    // start a replay stream, before the first `write_replay_event`
+    static void write_replay_header( std::ostream& out )
+    {
+        replay_header header {};
+        memcpy( header.magic, REPLAY_MAGIC, sizeof(REPLAY_MAGIC) );
+        header.version = REPLAY_VERSION;
+        header.byte_order = SNAPSHOT_BYTE_ORDER;
+        header.layout = SNAPSHOT_LAYOUT;
+        out.write( reinterpret_cast<const char*>(&header), sizeof(header) );
+    }
+
+    /**
+     * ## STATIC `write_replay_event`
+     *
+     * Append a row change at block {time} to a replay stream started with `write_replay_header`
+     *
+     * ### example
+     *
+     * ```c++
+     * std::ofstream out( "history.replay", std::ios::binary );
+     * pizzalend::write_replay_header( out );
+     * pizzalend::write_replay_event( out, 1650000000, loan );              // loan inserted or modified
+     * pizzalend::write_replay_event( out, 1650000001, collateral, true );  // collateral removed
+     * ```
+     */
+    template <typename T>
+    static void write_replay_event( std::ostream& out, const uint64_t time, const T& row, const bool erase = false )
+    {
+        static_assert( std::is_trivially_copyable_v<T>, "pizzalend: replay rows must be trivially copyable" );
+        const replay_event event { time, get_replay_table<T>(), erase, 0, sizeof(T) };
+        out.write( reinterpret_cast<const char*>(&event), sizeof(event) );
+        out.write( reinterpret_cast<const char*>(&row), sizeof(T) );
+    }
+
+    /**
+     * ## STRUCT `LiquidationPolicy`
+     *
+     * Liquidation strategy under test: liquidation orders worth more than `min_value`
+     * are liquidated with the most profitable plan (`get_best_liquidation`).
+     * An order counts once until it is modified on chain, as we would have taken it in the block it was found.
+     */
+    struct LiquidationPolicy {
+        double      min_value = 0;
+        bool        respect_order = true;
+        double      min_profit = 0;         // skip plans with lower profit
+    };
+
+    struct ReplayBlock {
+        uint64_t    time;
+        uint32_t    events;             // rows changed in this block
+        uint32_t    orders;             // liquidation orders above `min_value`
+        uint32_t    opportunities;      // orders first found with a plan above `min_profit`
+        double      profit;             // sum of their plan profits
+        uint64_t    cpu_ns;             // policy evaluation time
+    };
+
+    struct ReplayStats {
+        uint64_t    blocks = 0;
+        uint64_t    events = 0;
+        uint64_t    orders = 0;
+        uint64_t    opportunities = 0;
+        double      profit = 0;
+        uint64_t    cpu_ns = 0;
+        uint64_t    max_cpu_ns = 0;     // slowest block
+    };
+
+    /**
+     * ## STRUCT `Replay`
+     *
+     * Streams a replay file block by block: the stream header is checked against this build's row layout
+     * and byte order, then row changes are applied in place to `MemoryTables`
+     * (keeping index order), then the policy runs against the updated tables with the same functions used on chain.
+     * Memory is bounded by the size of the market, not the length of the history.
+     *
+     * ### example
+     *
+     * ```c++
+     * pizzalend::Replay replay( initial_tables );
+     * std::ifstream in( "history.replay", std::ios::binary );
+     *
+     * const auto stats = replay.run( in, { .min_value = 10 }, [](const pizzalend::ReplayBlock& block) {
+     *     if(block.opportunities) printf("%llu: %u opportunities, %.2f profit\n", block.time, block.opportunities, block.profit);
+     * });
+     * // => { blocks: 2592000, events: 812233, orders: 9120, opportunities: 4211, profit: 15231.9, ... }
+     * ```
+     */
+    struct Replay {
+        MemoryTables    tables;
+
+        explicit Replay( MemoryTables initial ): tables( std::move(initial) ), reserves( tables ) {}
+
+        template <typename F>
+        ReplayStats run( std::istream& in, const LiquidationPolicy& policy, F&& on_block )
+        {
+            ReplayStats stats;
+            read_header( in );
+            replay_event event {};
+            bool pending = read_event( in, event );
+            while(pending) {
+                ReplayBlock block { event.time, 0, 0, 0, 0, 0 };
+                bool reserves_changed = false;
+                while(pending && event.time == block.time) {
+                    reserves_changed |= event.table == REPLAY_PZTOKEN;
+                    apply( event );
+                    ++block.events;
+                    pending = read_event( in, event );
+                    check( !pending || event.time >= block.time, "pizzalend: Replay: events out of order" );
+                }
+
+                tables.time = block.time;
+                if(reserves_changed) reserves = ReserveSnapshot( tables );
+                evaluate( policy, block );
+
+                ++stats.blocks;
+                stats.events += block.events;
+                stats.orders += block.orders;
+                stats.opportunities += block.opportunities;
+                stats.profit += block.profit;
+                stats.cpu_ns += block.cpu_ns;
+                stats.max_cpu_ns = std::max( stats.max_cpu_ns, block.cpu_ns );
+                on_block( block );
+            }
+            return stats;
+        }
+
+        ReplayStats run( std::istream& in, const LiquidationPolicy& policy )
+        {
+            return run( in, policy, [](const ReplayBlock&){} );
+        }
+
+    private:
+        ReserveSnapshot     reserves;
+        vector<char>        row;        // reused read buffer
+        std::unordered_map<uint64_t, uint64_t>  captured;   // liquidation order id => updated_at when taken
+
+        static void read_header( std::istream& in ) {
+            replay_header header {};
+            check( bool(in.read( reinterpret_cast<char*>(&header), sizeof(header) )), "pizzalend: Replay: missing stream header" );
+            check( memcmp( header.magic, REPLAY_MAGIC, sizeof(REPLAY_MAGIC) ) == 0, "pizzalend: Replay: not a replay stream" );
+            check( header.version == REPLAY_VERSION, "pizzalend: Replay: unsupported version" );
+            check( header.byte_order == SNAPSHOT_BYTE_ORDER, "pizzalend: Replay: byte order mismatch" );
+            check( header.layout == SNAPSHOT_LAYOUT, "pizzalend: Replay: row layout mismatch" );
+        }
+
+        bool read_event( std::istream& in, replay_event& event ) {
+            if(!in.read( reinterpret_cast<char*>(&event), sizeof(event) )) return false;
+            const uint32_t size = get_replay_row_size( event.table );
+            check( size != 0, "pizzalend: Replay: unknown table" );
+            check( event.size == size, "pizzalend: Replay: row layout mismatch" );
+            row.resize( event.size );
+            check( bool(in.read( row.data(), event.size )), "pizzalend: Replay: truncated event" );
+            return true;
+        }
+
+        // copy, the read buffer has no alignment guarantee for {T}
+        template <typename T>
+        T get_row() const {
+            check( row.size() == sizeof(T), "pizzalend: Replay: row layout mismatch" );
+            T res;
+            memcpy( &res, row.data(), sizeof(T) );
+            return res;
+        }
+
+        // insert, replace or erase {value} in rows sorted by {less}
+        template <typename T, typename Less>
+        static void apply( vector<T>& rows, const T& value, const bool erase, Less&& less ) {
+            const auto it = std::lower_bound(rows.begin(), rows.end(), value, less);
+            const bool found = it != rows.end() && !less(value, *it);
+            if(erase) {
+                if(found) rows.erase( it );
+            }
+            else if(found) *it = value;
+            else rows.insert( it, value );
+        }
+
+        void apply( const replay_event& event ) {
+            const auto by_account = [](const auto& a, const auto& b){ return std::tie(a.account.value, a.id) < std::tie(b.account.value, b.id); };
+            switch(event.table) {
+                case REPLAY_PZTOKEN:
+                    return apply( tables.reserves, get_row<pztoken_row>(), event.erase, [](const pztoken_row& a, const pztoken_row& b){ return a.pztoken < b.pztoken; } );
+                case REPLAY_COLLATERAL:
+                    return apply( tables.collaterals, get_row<collateral_row>(), event.erase, by_account );
+                case REPLAY_LOAN:
+                    return apply( tables.loans, get_row<loan_row>(), event.erase, by_account );
+                case REPLAY_LIQDTORDER: {
+                    const auto order = get_row<liqdtorder_row>();
+                    if(event.erase) captured.erase( order.id );
+                    return apply( tables.liqdtorders, order, event.erase, [](const liqdtorder_row& a, const liqdtorder_row& b){ return a.id < b.id; } );
+                }
+                case REPLAY_CACHEDHEALTH:
+                    return apply( tables.cachedhealths, get_row<cachedhealth_row>(), event.erase, [](const cachedhealth_row& a, const cachedhealth_row& b){ return a.account < b.account; } );
+            }
+            check( false, "pizzalend: Replay: unknown table" );
+        }
+
+        void evaluate( const LiquidationPolicy& policy, ReplayBlock& block ) {
+            const auto start = std::chrono::steady_clock::now();
+            for_each_liq_order( policy.min_value, reserves, [&](const liqdtorder_row& order, const double) {
+                ++block.orders;
+                const auto it = captured.find( order.id );
+                if(it != captured.end() && it->second == order.updated_at) return;
+                const AccountPosition position( order.account, reserves, tables );
+                const auto plan = get_best_liquidation( position, policy.respect_order );
+                if(plan.in.quantity.amount == 0 || plan.profit <= policy.min_profit) return;
+                ++block.opportunities;
+                block.profit += plan.profit;
+                captured[order.id] = order.updated_at;
+            }, tables );
+            block.cpu_ns = std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - start ).count();
+        }
+    };
+}
@@ -0,0 +1,386 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <fstream>
+#include <type_traits>
+
+#include "pizzalend.hpp"
+
+// Binary snapshots of `lend.pizza` tables for off-chain tools, memory-mapped on load (not for WASM contracts)
+namespace pizzalend {
+
+    constexpr char SNAPSHOT_MAGIC[8] = { 'P', 'Z', 'S', 'N', 'A', 'P', 0, 0 };
+    constexpr uint32_t SNAPSHOT_VERSION = 2;
+    constexpr uint64_t SNAPSHOT_ALIGN = 64;
+    constexpr uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304;    // reads back differently on a host of the other endianness
+
+    // FNV-1a of {value} bytes into {hash}
+    static constexpr uint64_t get_layout_hash( uint64_t hash, const uint64_t value ) {
+        for(int i = 0; i < 8; ++i) hash = (hash ^ ((value >> (i * 8)) & 0xff)) * 0x100000001b3ULL;
+        return hash;
+    }
+
+    template <typename T>
+    static constexpr uint64_t get_layout_hash( uint64_t hash, std::initializer_list<uint64_t> fields ) {
+        hash = get_layout_hash( get_layout_hash( hash, sizeof(T) ), alignof(T) );
+        for(const uint64_t field: fields) hash = get_layout_hash( hash, field );
+        return hash;
+    }
+
+    #define PIZZALEND_FIELD( T, field ) offsetof( T, field ), sizeof( T::field )
+
+    // size, alignment, field offsets and field sizes of every row struct stored in a snapshot
+    static constexpr uint64_t SNAPSHOT_LAYOUT = [] {
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        hash = get_layout_hash<name>( hash, {} );
+        hash = get_layout_hash<symbol>( hash, {} );
+        hash = get_layout_hash<extended_symbol>( hash, {} );
+        hash = get_layout_hash<asset>( hash, { PIZZALEND_FIELD( asset, amount ), PIZZALEND_FIELD( asset, symbol ) } );
+        hash = get_layout_hash<extended_asset>( hash, { PIZZALEND_FIELD( extended_asset, quantity ), PIZZALEND_FIELD( extended_asset, contract ) } );
+        hash = get_layout_hash<pztoken_config>( hash, {
+            PIZZALEND_FIELD( pztoken_config, base_rate ), PIZZALEND_FIELD( pztoken_config, max_rate ),
+            PIZZALEND_FIELD( pztoken_config, base_discount_rate ), PIZZALEND_FIELD( pztoken_config, max_discount_rate ),
+            PIZZALEND_FIELD( pztoken_config, best_usage_rate ), PIZZALEND_FIELD( pztoken_config, floating_fee_rate ),
+            PIZZALEND_FIELD( pztoken_config, fixed_fee_rate ), PIZZALEND_FIELD( pztoken_config, liqdt_rate ),
+            PIZZALEND_FIELD( pztoken_config, liqdt_bonus ), PIZZALEND_FIELD( pztoken_config, max_ltv ),
+            PIZZALEND_FIELD( pztoken_config, floating_rate_power ), PIZZALEND_FIELD( pztoken_config, is_collateral ),
+            PIZZALEND_FIELD( pztoken_config, can_stable_borrow ), PIZZALEND_FIELD( pztoken_config, borrow_liqdt_order ),
+            PIZZALEND_FIELD( pztoken_config, collateral_liqdt_order )
+        });
+        hash = get_layout_hash<pztoken_row>( hash, {
+            PIZZALEND_FIELD( pztoken_row, pztoken ), PIZZALEND_FIELD( pztoken_row, pzsymbol ), PIZZALEND_FIELD( pztoken_row, anchor ),
+            PIZZALEND_FIELD( pztoken_row, cumulative_deposit ), PIZZALEND_FIELD( pztoken_row, available_deposit ),
+            PIZZALEND_FIELD( pztoken_row, pzquantity ), PIZZALEND_FIELD( pztoken_row, borrow ),
+            PIZZALEND_FIELD( pztoken_row, cumulative_borrow ), PIZZALEND_FIELD( pztoken_row, variable_borrow ),
+            PIZZALEND_FIELD( pztoken_row, stable_borrow ), PIZZALEND_FIELD( pztoken_row, usage_rate ),
+            PIZZALEND_FIELD( pztoken_row, floating_rate ), PIZZALEND_FIELD( pztoken_row, discount_rate ),
+            PIZZALEND_FIELD( pztoken_row, price ), PIZZALEND_FIELD( pztoken_row, pzprice ), PIZZALEND_FIELD( pztoken_row, pzprice_rate ),
+            PIZZALEND_FIELD( pztoken_row, updated_at ), PIZZALEND_FIELD( pztoken_row, config )
+        });
+        hash = get_layout_hash<collateral_row>( hash, {
+            PIZZALEND_FIELD( collateral_row, id ), PIZZALEND_FIELD( collateral_row, account ), PIZZALEND_FIELD( collateral_row, pzname ),
+            PIZZALEND_FIELD( collateral_row, quantity ), PIZZALEND_FIELD( collateral_row, updated_at )
+        });
+        hash = get_layout_hash<loan_row>( hash, {
+            PIZZALEND_FIELD( loan_row, id ), PIZZALEND_FIELD( loan_row, account ), PIZZALEND_FIELD( loan_row, pzname ),
+            PIZZALEND_FIELD( loan_row, principal ), PIZZALEND_FIELD( loan_row, quantity ), PIZZALEND_FIELD( loan_row, type ),
+            PIZZALEND_FIELD( loan_row, fixed_rate ), PIZZALEND_FIELD( loan_row, turn_variable_countdown ),
+            PIZZALEND_FIELD( loan_row, last_calculated_at ), PIZZALEND_FIELD( loan_row, updated_at )
+        });
+        hash = get_layout_hash<liqdtorder_row>( hash, {
+            PIZZALEND_FIELD( liqdtorder_row, id ), PIZZALEND_FIELD( liqdtorder_row, account ), PIZZALEND_FIELD( liqdtorder_row, collateral ),
+            PIZZALEND_FIELD( liqdtorder_row, loan ), PIZZALEND_FIELD( liqdtorder_row, liqdted_at ), PIZZALEND_FIELD( liqdtorder_row, updated_at )
+        });
+        hash = get_layout_hash<cachedhealth_row>( hash, {
+            PIZZALEND_FIELD( cachedhealth_row, account ), PIZZALEND_FIELD( cachedhealth_row, loan_value ),
+            PIZZALEND_FIELD( cachedhealth_row, collateral_value ), PIZZALEND_FIELD( cachedhealth_row, factor ),
+            PIZZALEND_FIELD( cachedhealth_row, updated_at )
+        });
+        return hash;
+    }();
+
+    #undef PIZZALEND_FIELD
+
+    // snapshot sections, in file order
+    enum snapshot_section_id : uint32_t {
+        SNAPSHOT_RESERVES,                  // pztoken_row, by pztoken
+        SNAPSHOT_COLLATERALS,               // collateral_row, by account, id
+        SNAPSHOT_LOANS,                     // loan_row, by account, id
+        SNAPSHOT_LIQDTORDERS,               // liqdtorder_row, by id
+        SNAPSHOT_CACHEDHEALTHS,             // cachedhealth_row, by account
+        SNAPSHOT_COLLATERAL_ACCOUNTS,       // uint64_t, distinct collateral accounts in order
+        SNAPSHOT_COLLATERAL_OFFSETS,        // uint32_t, first collateral row of each account + total
+        SNAPSHOT_LOAN_ACCOUNTS,             // uint64_t, distinct loan accounts in order
+        SNAPSHOT_LOAN_OFFSETS,              // uint32_t, first loan row of each account + total
+        SNAPSHOT_COLLATERAL_BYACCPZNAME,    // uint32_t, collateral rows by account, pzname, id
+        SNAPSHOT_LOAN_BYACCPZNAME,          // uint32_t, loan rows by account, pzname, id
+        SNAPSHOT_SECTIONS
+    };
+
+    struct snapshot_section {
+        uint64_t    offset;         // from start of file, SNAPSHOT_ALIGN aligned
+        uint64_t    count;
+        uint32_t    item_size;      // sizeof item, must match the reader's struct
+        uint32_t    reserved;
+    };
+
+    struct snapshot_header {
+        char                magic[8];
+        uint32_t            version;
+        uint32_t            sections;
+        uint32_t            byte_order; // SNAPSHOT_BYTE_ORDER as written
+        uint32_t            reserved;
+        uint64_t            layout;     // SNAPSHOT_LAYOUT of the writer
+        uint64_t            time;       // snapshot time in seconds since epoch
+        snapshot_section    section[SNAPSHOT_SECTIONS];
+    };
+
+    /**
+     * ## STATIC `write_snapshot`
+     *
+     * Write tables to {path} as a binary snapshot: one aligned section per table holding rows in the same
+     * layout as the row structs, followed by the `byaccount` account => rows offsets and the `byaccpzname`
+     * row order of `collateral` and `loan`. Readers built with a different row layout or byte order reject it.
+     *
+     * ### params
+     *
+     * - `{string} path` - output file
+     * - `{MemoryTables} tables` - tables to write, `time` is kept as the snapshot time
+     *
+     * ### example
+     *
+     * ```c++
+     * pizzalend::write_snapshot( "lend.pizza.snap", tables );
+     * ```
+     */
+    static void write_snapshot( const std::string& path, const MemoryTables& tables )
+    {
+        // account => first row offsets, equivalent to the on-chain `byaccount` index
+        const auto get_offsets = [](const auto& rows, vector<uint64_t>& accounts, vector<uint32_t>& offsets) {
+            for(uint32_t i = 0; i < rows.size(); ++i) {
+                if(!accounts.empty() && accounts.back() == rows[i].account.value) continue;
+                accounts.push_back( rows[i].account.value );
+                offsets.push_back( i );
+            }
+            offsets.push_back( rows.size() );
+        };
+        vector<uint64_t> collateral_accounts, loan_accounts;
+        vector<uint32_t> collateral_offsets, loan_offsets;
+        get_offsets( tables.collaterals, collateral_accounts, collateral_offsets );
+        get_offsets( tables.loans, loan_accounts, loan_offsets );
+
+        // rows are in account order already, so `byaccpzname` only reorders rows within each account
+        const auto get_byaccpzname = [](const auto& rows) {
+            vector<uint32_t> order( rows.size() );
+            for(uint32_t i = 0; i < rows.size(); ++i) order[i] = i;
+            std::stable_sort(order.begin(), order.end(), [&](const uint32_t a, const uint32_t b) {
+                return std::tie(rows[a].account.value, rows[a].pzname.value) < std::tie(rows[b].account.value, rows[b].pzname.value);
+            });
+            return order;
+        };
+        const vector<uint32_t> collateral_byaccpzname = get_byaccpzname( tables.collaterals );
+        const vector<uint32_t> loan_byaccpzname = get_byaccpzname( tables.loans );
+
+        snapshot_header header {};
+        memcpy( header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC) );
+        header.version = SNAPSHOT_VERSION;
+        header.sections = SNAPSHOT_SECTIONS;
+        header.byte_order = SNAPSHOT_BYTE_ORDER;
+        header.layout = SNAPSHOT_LAYOUT;
+        header.time = tables.time;
+
+        struct payload {
+            const void*     data;
+            uint64_t        count;
+            uint32_t        item_size;
+        };
+        const auto get_payload = [](const auto& items) -> payload {
+            using T = typename std::decay_t<decltype(items)>::value_type;
+            static_assert( std::is_trivially_copyable_v<T>, "pizzalend: snapshot rows must be trivially copyable" );
+            return { items.data(), items.size(), sizeof(T) };
+        };
+        const payload payloads[SNAPSHOT_SECTIONS] = {
+            get_payload( tables.reserves ), get_payload( tables.collaterals ), get_payload( tables.loans ),
+            get_payload( tables.liqdtorders ), get_payload( tables.cachedhealths ),
+            get_payload( collateral_accounts ), get_payload( collateral_offsets ),
+            get_payload( loan_accounts ), get_payload( loan_offsets ),
+            get_payload( collateral_byaccpzname ), get_payload( loan_byaccpzname )
+        };
+
+        const auto align = [](const uint64_t offset) { return (offset + SNAPSHOT_ALIGN - 1) / SNAPSHOT_ALIGN * SNAPSHOT_ALIGN; };
+        uint64_t offset = align( sizeof(header) );
+        for(uint32_t i = 0; i < SNAPSHOT_SECTIONS; ++i) {
+            header.section[i] = { offset, payloads[i].count, payloads[i].item_size, 0 };
+            offset = align( offset + payloads[i].count * payloads[i].item_size );
+        }
+
+        std::ofstream out( path, std::ios::binary | std::ios::trunc );
+        check( out.good(), "pizzalend: write_snapshot(): can't open " + path );
+        const char padding[SNAPSHOT_ALIGN] = {};
+        uint64_t written = 0;
+        const auto write = [&](const void* data, const uint64_t size) {
+            out.write( static_cast<const char*>(data), size );
+            written += size;
+        };
+        write( &header, sizeof(header) );
+        for(uint32_t i = 0; i < SNAPSHOT_SECTIONS; ++i) {
+            write( padding, header.section[i].offset - written );
+            write( payloads[i].data, payloads[i].count * payloads[i].item_size );
+        }
+        out.flush();
+        check( out.good(), "pizzalend: write_snapshot(): can't write " + path );
+    }
+
+    /**
+     * ## STRUCT `MappedSnapshot`
+     *
+     * Read-only memory map of a snapshot written by `write_snapshot`. Tables are exposed as spans into the
+     * mapping without parsing or copying, so loading is constant time and processes mapping the same file
+     * share its page cache. It has the same members as `ChainTables` and can be passed as `tables`.
+     *
+     * ### example
+     *
+     * ```c++
+     * const pizzalend::MappedSnapshot tables( "lend.pizza.snap" );
+     * const pizzalend::ReserveSnapshot reserves( tables );
+     *
+     * const double health_factor = pizzalend::get_health_factor( "myusername"_n, reserves, tables );
+     * // => 1.2345
+     * ```
+     */
+    struct MappedSnapshot {
+        explicit MappedSnapshot( const std::string& path ) {
+            const int fd = ::open( path.c_str(), O_RDONLY );
+            check( fd >= 0, "pizzalend: MappedSnapshot: can't open " + path );
+            struct stat st {};
+            const bool stated = ::fstat( fd, &st ) == 0;
+            size = stated ? st.st_size : 0;
+            if(size >= sizeof(snapshot_header)) {
+                data = ::mmap( nullptr, size, PROT_READ, MAP_SHARED, fd, 0 );
+                if(data == MAP_FAILED) data = nullptr;
+            }
+            ::close( fd );
+            check( data != nullptr, "pizzalend: MappedSnapshot: can't map " + path );
+
+            header = static_cast<const snapshot_header*>(data);
+            check( memcmp( header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC) ) == 0, "pizzalend: MappedSnapshot: not a snapshot" );
+            check( header->version == SNAPSHOT_VERSION && header->sections == SNAPSHOT_SECTIONS, "pizzalend: MappedSnapshot: unsupported version" );
+            check( header->byte_order == SNAPSHOT_BYTE_ORDER, "pizzalend: MappedSnapshot: byte order mismatch" );
+            check( header->layout == SNAPSHOT_LAYOUT, "pizzalend: MappedSnapshot: row layout mismatch" );
+
+            reserves = get_section<pztoken_row>( SNAPSHOT_RESERVES );
+            collaterals = get_section<collateral_row>( SNAPSHOT_COLLATERALS );
+            loans = get_section<loan_row>( SNAPSHOT_LOANS );
+            liqdtorders = get_section<liqdtorder_row>( SNAPSHOT_LIQDTORDERS );
+            cachedhealths = get_section<cachedhealth_row>( SNAPSHOT_CACHEDHEALTHS );
+            collateral_accounts = get_section<uint64_t>( SNAPSHOT_COLLATERAL_ACCOUNTS );
+            collateral_offsets = get_section<uint32_t>( SNAPSHOT_COLLATERAL_OFFSETS );
+            loan_accounts = get_section<uint64_t>( SNAPSHOT_LOAN_ACCOUNTS );
+            loan_offsets = get_section<uint32_t>( SNAPSHOT_LOAN_OFFSETS );
+            collateral_byaccpzname = get_section<uint32_t>( SNAPSHOT_COLLATERAL_BYACCPZNAME );
+            loan_byaccpzname = get_section<uint32_t>( SNAPSHOT_LOAN_BYACCPZNAME );
+            check_accounts( collateral_accounts, collateral_offsets, collaterals.size() );
+            check_accounts( loan_accounts, loan_offsets, loans.size() );
+            check( collateral_byaccpzname.size() == collaterals.size() && loan_byaccpzname.size() == loans.size(), "pizzalend: MappedSnapshot: invalid byaccpzname order" );
+            for(const uint32_t i: collateral_byaccpzname) check( i < collaterals.size(), "pizzalend: MappedSnapshot: invalid byaccpzname order" );
+            for(const uint32_t i: loan_byaccpzname) check( i < loans.size(), "pizzalend: MappedSnapshot: invalid byaccpzname order" );
+        }
+
+        MappedSnapshot( const MappedSnapshot& ) = delete;
+        MappedSnapshot& operator=( const MappedSnapshot& ) = delete;
+
+        ~MappedSnapshot() {
+            if(data) ::munmap( data, size );
+        }
+
+        std::span<const pztoken_row>        reserves;       // by pztoken
+        std::span<const collateral_row>     collaterals;    // by account, id
+        std::span<const loan_row>           loans;          // by account, id
+        std::span<const liqdtorder_row>     liqdtorders;    // by id
+        std::span<const cachedhealth_row>   cachedhealths;  // by account
+
+        // rows of {account}, equivalent to the on-chain `byaccount` index
+        std::span<const collateral_row> get_collaterals( const name account ) const {
+            return get_rows( collaterals, collateral_accounts, collateral_offsets, account );
+        }
+
+        std::span<const loan_row> get_loans( const name account ) const {
+            return get_rows( loans, loan_accounts, loan_offsets, account );
+        }
+
+        // rows of {account} in {pzname}, equivalent to the on-chain `byaccpzname` index
+        template <typename F>
+        void for_each_collateral( const name account, const name pzname, F&& f ) const {
+            for_each_row( collaterals, collateral_accounts, collateral_offsets, collateral_byaccpzname, account, pzname, f );
+        }
+
+        template <typename F>
+        void for_each_loan( const name account, const name pzname, F&& f ) const {
+            for_each_row( loans, loan_accounts, loan_offsets, loan_byaccpzname, account, pzname, f );
+        }
+
+        template <typename F>
+        void for_each_reserve( F&& f ) const {
+            for(const auto& row: reserves) f(row);
+        }
+
+        template <typename F>
+        void for_each_collateral( const name account, F&& f ) const {
+            for(const auto& row: get_collaterals( account )) f(row);
+        }
+
+        template <typename F>
+        void for_each_loan( const name account, F&& f ) const {
+            for(const auto& row: get_loans( account )) f(row);
+        }
+
+        template <typename F>
+        bool for_each_liqdtorder( const uint64_t start_id, F&& f ) const {
+            auto it = std::lower_bound(liqdtorders.begin(), liqdtorders.end(), start_id, [](const liqdtorder_row& row, const uint64_t id){ return row.id < id; });
+            for(; it != liqdtorders.end(); ++it)
+                if(!f(*it)) return false;
+            return true;
+        }
+
+        uint64_t now() const {
+            return header->time;
+        }
+
+        std::optional<cachedhealth_row> get_cachedhealth( const name account ) const {
+            const auto it = std::lower_bound(cachedhealths.begin(), cachedhealths.end(), account.value, [](const cachedhealth_row& row, const uint64_t value){ return row.account.value < value; });
+            if(it == cachedhealths.end() || it->account != account) return std::nullopt;
+            return *it;
+        }
+
+    private:
+        void*                       data = nullptr;
+        size_t                      size = 0;
+        const snapshot_header*      header = nullptr;
+        std::span<const uint64_t>   collateral_accounts;
+        std::span<const uint32_t>   collateral_offsets;
+        std::span<const uint64_t>   loan_accounts;
+        std::span<const uint32_t>   loan_offsets;
+        std::span<const uint32_t>   collateral_byaccpzname;
+        std::span<const uint32_t>   loan_byaccpzname;
+
+        // accounts strictly increasing, their row offsets non-decreasing from 0 to {rows}
+        static void check_accounts( std::span<const uint64_t> accounts, std::span<const uint32_t> offsets, const size_t rows ) {
+            check( offsets.size() == accounts.size() + 1 && offsets.front() == 0 && offsets.back() == rows, "pizzalend: MappedSnapshot: invalid account offsets" );
+            for(size_t i = 1; i < offsets.size(); ++i) check( offsets[i - 1] <= offsets[i], "pizzalend: MappedSnapshot: invalid account offsets" );
+            for(size_t i = 1; i < accounts.size(); ++i) check( accounts[i - 1] < accounts[i], "pizzalend: MappedSnapshot: unsorted accounts" );
+        }
+
+        template <typename T>
+        std::span<const T> get_section( const snapshot_section_id id ) const {
+            const auto& section = header->section[id];
+            check( section.item_size == sizeof(T), "pizzalend: MappedSnapshot: row layout mismatch" );
+            check( section.offset % alignof(T) == 0 && section.offset <= size && section.count <= (size - section.offset) / sizeof(T), "pizzalend: MappedSnapshot: truncated snapshot" );
+            return { reinterpret_cast<const T*>( static_cast<const char*>(data) + section.offset ), section.count };
+        }
+
+        template <typename T>
+        static std::span<const T> get_rows( std::span<const T> rows, std::span<const uint64_t> accounts, std::span<const uint32_t> offsets, const name account ) {
+            const auto it = std::lower_bound(accounts.begin(), accounts.end(), account.value);
+            if(it == accounts.end() || *it != account.value) return {};
+            const size_t i = it - accounts.begin();
+            return rows.subspan( offsets[i], offsets[i + 1] - offsets[i] );
+        }
+
+        // the `byaccpzname` order of an account's rows spans the same positions as its `byaccount` rows
+        template <typename T, typename F>
+        static void for_each_row( std::span<const T> rows, std::span<const uint64_t> accounts, std::span<const uint32_t> offsets,
+                                  std::span<const uint32_t> order, const name account, const name pzname, F& f ) {
+            const auto it = std::lower_bound(accounts.begin(), accounts.end(), account.value);
+            if(it == accounts.end() || *it != account.value) return;
+            const size_t i = it - accounts.begin();
+            const auto range = order.subspan( offsets[i], offsets[i + 1] - offsets[i] );
+            auto pos = std::lower_bound(range.begin(), range.end(), pzname.value, [&](const uint32_t row, const uint64_t value){ return rows[row].pzname.value < value; });
+            for(; pos != range.end() && rows[*pos].pzname == pzname; ++pos) f(rows[*pos]);
+        }
+    };
+}